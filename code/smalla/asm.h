@@ -11,9 +11,11 @@
 #define MAXFN       41          /* max file name space */
 #define MAXNAM      31          /* maximum name characters */
 #define MAXLINE     81          /* length of source line */
+#define MAXEXP     161          /* length of expanded macro line */
 #define LASTLINE    60          /* last line of listing page */
 #define SRCEXT   ".ASM"         /* source file extension */
 #define OBJEXT   ".OBJ"         /* object file extension */
+#define XRFEXT   ".XRF"         /* cross-reference file extension */
 
 /*
 ** symbol table
@@ -30,6 +32,8 @@
 **   STSIZE       
 **             Ŀ
 **   STFLAGS          
+**             Ĵ
+**   STHASH           
 **             
 **   STENTRY
 **
@@ -40,9 +44,11 @@
 #define STNDX   (STVAL1  + 2)   /* offset to object file index */
 #define STSIZE  (STNDX   + 1)   /* offset to data definition size */
 #define STFLAGS (STSIZE  + 1)   /* offset to flag word */
-#define STENTRY (STFLAGS + 2)   /* st entry size */
-#define STMAX     1000          /* maximum lables allowed */
-#define STRAVG      10          /* average symbol string size */
+#define STHASH  (STFLAGS + 2)   /* offset to full hash of name */
+#define STENTRY (STHASH  + 2)   /* st entry size */
+#define STSLOTS    256          /* initial hash slots (power of 2) */
+#define STCHUNK     32          /* entries allocated at a time */
+#define STRCHUNK   512          /* string bytes allocated at a time */
 
 /*
 ** symbol flags
@@ -63,8 +69,23 @@
 /*
 ** macro table
 */
-#define MTNXT        0          /* pointer to next macro */
+#define MTNXT        0          /* pointer to next macro in slot */
 #define MTNAM        2          /* macro name */
+#define MTSLOTS     64          /* directory slots (power of 2) */
+#define MTPARM    0x01          /* body: parameter slot (1-10) follows */
+#define MTLABEL   0x02          /* body: label slot (1-10) follows */
+
+/*
+** line cache (pass 1 keeps each line for pass 2 to replay)
+*/
+#define LNLEN        0          /* record length */
+#define LNFLG        1          /* which fields are known */
+#define LNMN         2          /* mnemonic index, else EOF */
+#define LNSYM        4          /* label st entry pointer */
+#define LNLP         6          /* line offset just past label */
+#define LNTEXT       7          /* source line */
+#define LNFMN     0x01          /* LNMN is known */
+#define LNFSYM    0x02          /* LNSYM and LNLP are known */
 
 /*
 ** macro p-codes
@@ -3,8 +3,8 @@
 **
 ** Copyright 1988 J. E. Hendrix
 **
-** Usage: ASM source [object] [-C] [-L] [-NM] [-P] [-S#]
-**        ASM source [object] [/C] [/L] [/NM] [/P] [/S#]
+** Usage: ASM source [object] [-1] [-C] [-L] [-NM] [-P] [-S#] [-X]
+**        ASM source [object] [/1] [/C] [/L] [/NM] [/P] [/S#] [/X]
 **
 ** Command-line arguments may be given in any order.  Switches may be
 ** introduced by a hyphen or a slash.  The brackets indicate optional
@@ -20,6 +20,13 @@
 **          will go to a file bearing the same name and path as the
 **          source file, but with a OBJ extension.
 **
+** -1       Assemble in a single pass.  Object code is kept in memory
+**          and forward and external references are patched in when
+**          END is reached.  Implies -NM and is ignored with -L.
+**          Forward references are always assembled in their long
+**          forms, and must be labels or variables, optionally plus
+**          or minus a constant.
+**
 ** -C       Use case sensitivity.  Without this switch, all symbols are
 **          converted to upper-case.  With this switch, they are taken
 **          as is; upper- and lower-case variants of the same letter are
@@ -31,10 +38,20 @@
 **
 ** -NM      No macro processing.  This speeds up the assembler somewhat.
 **          Macro processing is NOT needed for Small-C output files.
+**          Pass 1 also keeps the source lines in memory, with their
+**          labels and mnemonics looked up, so that pass 2 need not
+**          read and scan them again.  A source too large for memory
+**          is simply read again.
 **
 ** -P       Pause on errors waiting for an ENTER keystroke.
 **
-** -S#      Set symbol table size to accept # symbols.  Default is 1000.
+** -S#      Presize the symbol table for # symbols.  The table grows as
+**          needed, so this only saves rehashing on very large files.
+**
+** -X       Write the symbol table to a cross-reference file for other
+**          programs to read.  It bears the name and path of the object
+**          file, but with a XRF extension.  Each line gives a symbol's
+**          name, value, size, segment, and attributes.
 */
 #include <stdio.h>
 #include "notice.h"
@@ -52,16 +69,20 @@ extern unsigned
 ** symbol table
 */
 unsigned
-   stmax = STMAX,       /* maximum symbols */
+   stmax,               /* expected symbols (-S#), else zero */
    stn,                 /* number of symbols loaded */
+   stpmax,              /* stp[] capacity, 3/4 of hash slots */
+   sthmax,              /* hash slots (power of 2) */
+   sthslot,             /* slot of last stfind() */
+   sthval,              /* hash of last stfind() */
+  *sth,                 /* hash table of st entry pointers */
   *stp;                 /* symbol table pointer array */
 unsigned char
-  *st,                  /* symbol table buffer */
-  *stend,               /* end of symbol table */
+  *stnext,              /* next free st entry */
+  *stend,               /* end of st entry chunk */
   *stptr,               /* st entry pointer */
-  *strbuf,              /* st string buffer */
-  *strnxt,              /* next byte in string buffer */
-  *strend,              /* end of string buffer */
+  *strnxt,              /* next byte in string chunk */
+  *strend,              /* end of string chunk */
    stsym[MAXNAM+1];     /* temporary symbol space */
 
 /*
@@ -69,10 +90,22 @@ unsigned char
 */
 unsigned char
   *mt,                  /* macro table buffer */
-  *mtprev,              /* previous mt entry */
   *mtnext,              /* next available mt byte */
   *mtend,               /* end of macro table */
-  *mtptr;               /* mt entry pointer */
+  *mtptr,               /* mt entry pointer */
+  *mlptr;               /* macro body line being expanded */
+unsigned
+   mtdir[MTSLOTS];      /* macro directory, heads of hash chains */
+
+/*
+** single pass object log (shares the macro table space)
+** also holds the line cache for pass 2 when assembling with -NM
+*/
+unsigned char
+  *olbuf,               /* object log buffer */
+  *ollast,              /* last log record */
+  *olnext,              /* next available log byte */
+  *lnrec;               /* line cache record for this line, else 0 */
 
 /*
 ** miscellaneous variables
@@ -80,8 +113,11 @@ unsigned char
 unsigned
   debug,                /* debugging displays? */
   list,                 /* generate a listing? */
+  xref,                 /* write a cross-reference file? */
   pause,                /* pause on errors? */
   macros = YES,         /* macro processing? */
+  onepass,              /* single pass with end-of-pass patching? */
+  lncache,              /* line cache in use? */
   upper = YES,          /* upper-case symbols? */
   pass = 1,             /* which pass? */
   use,                  /* 2 = USE16, 4 = USE32 */
@@ -123,9 +159,10 @@ unsigned char
  *exthead,              /* head of extrn chain in symbol table */
   locstr[9],            /* ASCII version of location counter */
   locnull[]="        ", /* null ASCII location counter */
-  line[MAXLINE],        /* source line */
+  line[MAXEXP],         /* source line (or expanded macro line) */
   srcfn[MAXFN+4],       /* source filename */
   ofn[MAXFN+4],         /* object filename */
+  xfn[MAXFN+4],         /* cross-reference filename */
   omt[MAXFN+4],         /* object module title */
  *proptr,               /* current procedure st pointer */
  *segptr,               /* current segment st pointer */
@@ -160,15 +197,16 @@ main(argc, argv) int argc, *argv; {
 pass1(argc, argv) int argc, *argv; {
   unsigned max;
   fputs("pass 1\n", stderr);
-  st     = calloc(stmax*STENTRY, 1); /* allocate zeroed symbol table */ 
-  stp    = calloc(stmax, 2);         /* allocate symbol table ptr array */
-  stend  = st + stmax*STENTRY;       /* note end of table */
-  strbuf =
-  strnxt = malloc(stmax*STRAVG);     /* allocate string buffer */
-  strend = strbuf + stmax*STRAVG;    /* note end of buffer */
-  max    = avail(YES) - (STACK + OSIZE + FSIZE);
+  max    = avail(YES) - (STACK + (DSLOTS + 1) * (OSIZE + FSIZE));
   mt     = mtnext = calloc(max, 1);  /* allocate space */
   mtend  = mt + max - MAXLINE;       /* note end of macro buffer */
+  olbuf  = olnext = mt;              /* or object log if single pass */
+  sthmax = STSLOTS;                  /* symbols taken from the top */
+  while(sthmax < 0x8000 && sthmax - (sthmax >> 2) < stmax)
+    sthmax <<= 1;
+  lncache = !macros && !onepass;     /* line cache for pass 2? */
+  sth    = topmem(sthmax << 1);
+  stp    = topmem((stpmax = sthmax - (sthmax >> 2)) << 1);
   init();                            /* set initial conditions */
   dopass(argc, argv);                /* do pass 1 */
   }
@@ -178,7 +216,8 @@ pass1(argc, argv) int argc, *argv; {
 */
 pass2(argc, argv) int argc, *argv; {
   int i;
-  fputs("pass 2\n", stderr);
+  if(onepass) fputs("patch\n",  stderr);
+  else        fputs("pass 2\n", stderr);
   ofd   = open(ofn, "w");
   nosegs();           /* reset seg reg assumptions */
   putTHEADR(omt);
@@ -188,14 +227,18 @@ pass2(argc, argv) int argc, *argv; {
   putEXTs();
   putPUBs();
   segptr = proptr = use = 0;
-  pass = 2;
-  dopass(argc, argv);
+  if(onepass) replay();         /* write and patch object log */
+  else {
+    pass = 2;
+    dopass(argc, argv);
+    }
   putMODEND(valuse(endv), enda, F_F_SI, ends, F_T_SID, ends, endv);
   if(list) {
     errshow(stdout);
     symlist();
     }
   errshow(stderr);
+  if(xref) symxref();
   if(ferror(ofd))
     error("- Error in Object File");
   close(ofd);
@@ -208,6 +251,7 @@ dopass(argc, argv) int argc, *argv; {
   int mop;
   int i;
   mlnext = lpage = i = lin = loc[0] = loc[1] = 0;   /* reset everything */
+  lnrec = 0;
   lline = 100;                          /* force page heading */
   while(getarg(++i, srcfn, MAXFN, argc, argv) != EOF) {
     if(isswitch(srcfn[0])
@@ -260,16 +304,16 @@ dopass(argc, argv) int argc, *argv; {
           }
         }
       endline();                        /* end a listing line */
-      if(pass == 2)  gripe();           /* gripe about errors */
+      if(pass == 2 || onepass) gripe(); /* gripe about errors */
       if(expmode)  getmac();            /* fetch next macro line */
       else {
 
         input:
-        if(eom || !fgets(line, MAXLINE, srcfd))  break;
+        if(eom || !nextline())  break;
         if(debug && (!list || pass == 1)) fputs(line, stdout);
         }
       }
-    if(pass == 2) {
+    if(pass == 2 || onepass) {
       if(defmode)   {outerr("- Missing ENDM\n"); errors++;}
       else if(!eom) {outerr("- Missing END\n" ); errors++;}
       }
@@ -279,11 +323,54 @@ dopass(argc, argv) int argc, *argv; {
   error("- No Source File");
   }
 
+/*
+** get the next source line, from the line cache on pass 2
+** return true if there is one
+*/
+nextline() {
+  if(pass == 2 && lncache) {
+    if(lnrec) lnrec += lnrec[LNLEN];
+    else      lnrec  = olbuf;
+    if(lnrec >= olnext) return (NO);
+    strcpy(line, lnrec + LNTEXT);
+    return (YES);
+    }
+  if(!fgets(line, MAXLINE, srcfd)) return (NO);
+  if(pass == 1 && lncache) {
+    lnrec = olnext;
+    olnext += LNTEXT + strlen(line) + 1;
+    if(olnext > mtend) lndrop();       /* too large, read it again */
+    else {
+      lnrec[LNLEN] = olnext - lnrec;
+      lnrec[LNFLG] = 0;
+      strcpy(lnrec + LNTEXT, line);
+      }
+    }
+  return (YES);
+  }
+
+/*
+** abandon the line cache, pass 2 will read the source again
+*/
+lndrop() {
+  olnext = olbuf;
+  lnrec = lncache = 0;
+  }
+
 /*
 ** detect label and store it with location counter
 ** return true if the line is not empty
 */
 dolabel() {
+  if(lnrec && (lnrec[LNFLG] & LNFSYM)) { /* pass 2, label known */
+    stptr = getint(lnrec + LNSYM);
+    strcpy(stsym, symbol(stptr));
+    lp = line + lnrec[LNLP];
+    badsym = gotcomma = NO;
+    gotcolon = gotnam = YES;
+    labchk();
+    return (YES);
+    }
   lp = skip(1, line);                /* locate first field */
   if(atend(*lp)) {                   /* null or comment line */
     noloc();                         /* don't list loc */
@@ -298,7 +385,9 @@ dolabel() {
     if(pass == 1) {                    /* pass 1 */
       if(stfind()) {
         if(flags(stptr) & ~FPUB) {
-          orflags(stptr, FRED);        /* report on pass 2 */
+          if(onepass) rederr();        /* no pass 2 to report on */
+          else orflags(stptr, FRED);   /* report on pass 2 */
+          lnlabel();
           return (YES);
           }
         }
@@ -306,19 +395,36 @@ dolabel() {
       setval2(stptr, loc);             /* set value */
       orflags(stptr, FCOD);            /* set flags */
       stptr[STNDX] = segndx;           /* set segment index */
+      lnlabel();
       }
     else {                             /* pass 2 */
-      if(stfind()) {
-        if( flags(stptr) & ~(FCOD|FFAR|FPUB)) rederr();
-        if((flags(stptr) & FRED) == 0
-        && cmp32(stptr + STVAL2, loc)) phserr();
-        }
+      if(stfind()) labchk();
       else error2("+ Lost Label on Pass 2: ", line);
       }
     }
   return (YES);
   }
 
+/*
+** check a label on pass 2
+*/
+labchk() {
+  if( flags(stptr) & ~(FCOD|FFAR|FPUB)) rederr();
+  if((flags(stptr) & FRED) == 0
+  && cmp32(stptr + STVAL2, loc)) phserr();
+  }
+
+/*
+** note the label's st entry in the line cache
+*/
+lnlabel() {
+  if(lnrec) {
+    putint(lnrec + LNSYM, stptr);
+    lnrec[LNLP] = lp - line;
+    lnrec[LNFLG] |= LNFSYM;
+    }
+  }
+
 /*****************************************************************
                       macro facility
 *****************************************************************/
@@ -328,6 +434,7 @@ dolabel() {
 */
 getmac() {
   char *cp; cp = line;
+  mlptr = mtptr;
   while(*cp++ = *mtptr++)  ;
   }
 
@@ -351,36 +458,68 @@ macover(ptr) char *ptr; {
   }
 
 /*
-** find stsym in macro table
+** take n zeroed bytes from the top of the macro buffer
+** (symbol table space grows down toward the macros)
+*/
+topmem(n) unsigned n; {
+  unsigned char *cp;
+  if(lncache && pass == 1 && mtend - n < olnext)
+    lndrop();                       /* symbols come first */
+  if(mtend - n < mtnext || mtend - n < olnext)
+    error2("+ Symbol Table Overflow at: ", line);
+  mtend -= n;
+  cp = mtend + MAXLINE;             /* keep macover() margin */
+  pad(cp, 0, n);
+  return (cp);
+  }
+
+/*
+** find the field at lp in macro table
 ** return true if found, else false
 ** leave mtptr pointing to body of desired macro
 */
 mtfind() {
   if(atend(*lp) == 0) {
-    mtptr = mt;
-    do {
+    mtptr = mtdir[mtslot(lp)];       /* empty slot, not a macro */
+    while(mtptr) {
       if(same(lp, mtptr+MTNAM)) {
         mtptr += MTNAM;
         mtptr += strlen(mtptr) + 1;
         return (YES);
         }
       mtptr = getint(mtptr);
-      } while(mtptr);
+      }
     }
   return (NO);
   }
 
+/*
+** hash the field at cp to a macro directory slot
+** (the field ends where same() would end it)
+*/
+mtslot(cp) unsigned char *cp; {
+  unsigned h;
+  h = 0;
+  while(isgraph(*cp) && *cp != '(' && !atend(*cp))
+    h = (h << 1) + toupper(*cp++);
+  return (h & (MTSLOTS - 1));
+  }
+
 /*
 ** establish new macro
 */
 newmac() {
-  int i;
+  int i, h;
+  unsigned char *cp;
   i = 0;
   if(!gotnam || badsym)  symerr();
   else {
     macover(mtnext);
-    if(mtprev)  putint(mtprev, mtnext);
-    mtprev = mtnext;
+    if(cp = mtdir[h = mtslot(stsym)]) {
+      while(getint(cp)) cp = getint(cp);
+      putint(cp, mtnext);       /* append, so first definition rules */
+      }
+    else mtdir[h] = mtnext;
     putint(mtnext, 0);
     mtnext += 2;
     while(*mtnext++ = stsym[i++]) ;
@@ -388,13 +527,30 @@ newmac() {
   }
 
 /*
-** put a line in the macro buffer
+** put a line in the macro buffer, compiling ?n and @n
+** substitution markers into parameter and label slots
 */
 putmac() {
   char *cp;
   cp = line;
   macover(mtnext);              /* will buffer take it? */
-  while(*mtnext++ = *cp++)  ;   /* copy everything */
+  while(YES) {
+    if(*cp == '?') {                    /* substitution marker? */
+      if(isdigit(*++cp)) {              /* parameter slot */
+        *mtnext++ = MTPARM;
+        *mtnext++ = (*cp == '0') ? 10 : *cp - '0';
+        ++cp;
+        continue;
+        }
+      }
+    if(*cp == '@' && isdigit(cp[1])) {  /* label slot */
+      *mtnext++ = MTLABEL;
+      *mtnext++ = cp[1] - '0' + 1;
+      cp += 2;
+      continue;
+      }
+    if(!(*mtnext++ = *cp++)) break;     /* copy everything else */
+    }
   }
 
 /*
@@ -432,44 +588,42 @@ putparm() {
   }
 
 /*
-** replace parameters
+** replace parameters, gathering the body line's literal
+** text and its parameter and label slots into line[]
 */
 replace() {
-  char lin[MAXLINE], *cp, *cp2;
+  char *cp, *cp2;
   int ndx, i;
-  strcpy(lin, line);
-  cp = lin;
+  cp = mlptr;
   i = 0;
-  do {
-    if(*cp == '?') {                    /* substitution marker? */
-      if(isdigit(*++cp)) {              /* parameter substitution? */
-        ndx = *cp++ - '0' - 1;          /* which one? */
-        if(ndx < 0)  ndx = 9;           /* make 0 mean 10 */
-        if(cp2 = mpptr[ndx]) {          /* got parameter? */
-          while(*cp2)                   /* yes, copy it */
-            if(cantake(i, 1))  line[i++] = *cp2++;
-            }
-        continue;
+  while(*cp) {
+    if(*cp == MTPARM) {                         /* parameter slot? */
+      ndx = cp[1] - 1;
+      cp += 2;
+      if(cp2 = mpptr[ndx]) {                    /* got parameter? */
+        while(*cp2)                             /* yes, copy it */
+          if(cantake(i, 1))  line[i++] = *cp2++;
+          else break;
         }
+      continue;
       }
-    if(*cp == '@') {                            /* label substitution? */
+    if(*cp == MTLABEL) {                        /* label slot? */
+      ndx = cp[1] - 1;
+      cp += 2;
       if(cantake(i, 1))  line[i++] = '@';       /* insert label prefix */
-      if(isdigit(*++cp)) {                      /* which one? */
-        ndx = *cp++ - '0';
-        if(!mlnbr[ndx]) mlnbr[ndx] = ++mlnext;  /* need new label number? */
-        if(cantake(i, 5)) {
-          left(itou(mlnbr[ndx], line+i, 5));    /* insert label number */
-          while(line[i]) ++i;                   /* bypass label number */
-          }
-        continue;
+      if(!mlnbr[ndx]) mlnbr[ndx] = ++mlnext;    /* need new label number? */
+      if(cantake(i, 5)) {
+        left(itou(mlnbr[ndx], line+i, 5));      /* insert label number */
+        while(line[i]) ++i;                     /* bypass label number */
         }
+      continue;
       }
     if(cantake(i, 1))  line[i++] = *cp++;
     else {
       line[i++] = '\n';
       break;
       }
-    } while(*cp);
+    }
   line[i] = NULL;
   }
 
@@ -477,7 +631,7 @@ replace() {
 ** can line take more?
 */
 cantake(i, need) int i, need; {
-  return (i < (MAXLINE - 3) - need);
+  return (i < (MAXEXP - 3) - need);
   }
 
 /*****************************************************************
@@ -640,6 +794,8 @@ parms(argc, argv) int argc, *argv; {
       else if(same(arg+1, "P" ))  pause = YES;
       else if(same(arg+1, "D" ))  debug = YES;
       else if(same(arg+1, "NM")) macros = NO;
+      else if(same(arg+1, "1" )) onepass = YES;
+      else if(same(arg+1, "X" ))   xref = YES;
       else if(same(arg+1, "C" ))  upper = NO;
       else if(toupper(arg[1]) == 'S') {
         len = utoi(arg + 2, &j);
@@ -653,6 +809,8 @@ parms(argc, argv) int argc, *argv; {
       strcpy(strchr(ofn, '.'), OBJEXT);
       }
     }
+  if(list) onepass = NO;          /* listing needs pass 2 */
+  if(onepass) macros = NO;        /* log uses macro table space */
   strcpy(omt, ofn);               /* default object module title */
   }
 
@@ -668,9 +826,9 @@ isswitch(ch) char ch; {
 */
 usage() {
 #ifdef DEBUG
-  error("Usage: ASM source [object] [-C] [-D] [-L] [-NM] [-P] [-S#]");
+  error("Usage: ASM source [object] [-1] [-C] [-D] [-L] [-NM] [-P] [-S#] [-X]");
 #else
-  error("Usage: ASM source [object] [-C] [-L] [-NM] [-P] [-S#]");
+  error("Usage: ASM source [object] [-1] [-C] [-L] [-NM] [-P] [-S#] [-X]");
 #endif
   }
 
@@ -12,18 +12,60 @@
 #define EMAX   2        /* max expr subscript */
 #define LEDATA 1        /* began LEDATA */
 #define LIDATA 2        /* began LIDATA */
+#define RUNMIN 32       /* repeated data bytes worth a LIDATA block */
+
+/*
+** look cache entry (LCSIZE must be a power of 2)
+*/
+#define LCSIZE   64     /* entries in look cache */
+#define LCMN      0     /* mnemonic index */
+#define LCKEY1    1     /* raw types of opnds 1 and 2 */
+#define LCKEY2    2     /* raw type of opnd 3, osa, opnd count */
+#define LCOPND    3     /* resolved opnds[0] and opnds[1] */
+#define LCOPND2   4     /* resolved opnds[2] */
+#define LCMS      5     /* mitbuf[] subscript, 0 if empty */
+#define LCENTRY   6     /* words per entry */
+
+/*
+** single pass object log record
+*/
+#define OLABS     1     /* kind: absolute bytes */
+#define OLREP     2     /* kind: repeated bytes (DUP) */
+#define OLREL     3     /* kind: relocatable item */
+#define OLKIND    0     /* record kind */
+#define OLSEG     1     /* segment index */
+#define OLUSE     2     /* data record use */
+#define OLLEN     3     /* length of data (or of item if OLREP) */
+#define OLLOC     4     /* location counter (4 bytes) */
+#define OLDATA    8     /* OLABS data bytes */
+#define OLCNT     8     /* OLREP repetition count (2 bytes) */
+#define OLITEM   10     /* OLREP item bytes */
+#define OLMOD     8     /* OLREL fixup mode */
+#define OLLCN     9     /* OLREL fixup location */
+#define OLFRA    10     /* OLREL frame method */
+#define OLFNDX   11     /* OLREL frame index */
+#define OLTAR    12     /* OLREL target method */
+#define OLTNDX   13     /* OLREL target index */
+#define OLSYM    14     /* OLREL symbol to resolve, else zero (2 bytes) */
+#define OLVAL    16     /* OLREL value or addend (4 bytes) */
+#define OLRELSZ  20     /* OLREL record size */
 
 extern 
   asa,  badsym,  debug,  defuse,  enda,  ends,  endv[],
-  eom,  gotcolon,  gotnam,  ilen[],  iloc[],  inst[],  loc[],
-  osa,  pass,  seed,  segndx,  srpref[],  upper,  use;
+  eom,  errors,  gotcolon,  gotnam,  ilen[],  iloc[],  inst[],
+  loc[],  onepass,  osa,  pass,  seed,  segndx,  srpref[],  upper,
+  use;
 
 extern unsigned char
-  assume[],  *ep,  *exthead,  line[],  locstr[],  *lp,
-  *proptr,  *segptr,  *stptr,  *strend,  stsym[];
+  assume[],  *ep,  *exthead,  *fwdsym,  line[],  *lnrec,  locstr[],  *lp,
+  *mtend,  *olbuf,  *ollast,  *olnext,  *proptr,  *segptr,  *stptr,
+  *strend,  stsym[];
 
 int
   lookups,              /* total number of MIT lookups */
+  lchits,               /* lookups satisfied by look cache */
+  lcmisses,             /* lookups that searched the MIT */
+  lcache[LCSIZE*LCENTRY], /* look cache */
   x86,                  /* target which CPU */
   x87,                  /* target which NPX */
   dsrpx,                /* default seg reg pref index */
@@ -34,6 +76,9 @@ int
   curuse,               /* current use */
   zero[4],              /* 64-bit zero value */
   Srange,               /* S8 out of range? */
+  mnfirst,              /* first mnemonic on the line? */
+  runcnt,               /* repeated data items held back */
+  runloc[2],            /* location of first held back item */
   CScheck,              /* check for ASSUME CS:<current segment>? */
   ASOpref,              /* generate ASO prefix? (actual prefix) */
   OSOpref,              /* generate OSO prefix? (actual prefix) */
@@ -48,11 +93,13 @@ int
   eval[(EMAX+1)*8],     /* expression values (80 bits + 48 unused) */
   endx[ EMAX+1],        /* expression grp/seg index */
   etyp[(EMAX+1)*4],     /* expression type */
-  eflg[ EMAX+1];        /* expression flags */
+  eflg[ EMAX+1],        /* expression flags */
+  esym[ EMAX+1];        /* expression symbol to resolve at end */
 
 unsigned char
   wait = 0x9B,          /* WAIT instruction */ 
-  opnds[EMAX+2];        /* operand type buffer */ 
+  opnds[EMAX+2],        /* operand type buffer */ 
+  runval[10];           /* value of held back items */
 
 /*****************************************************************
                    machine instructions
@@ -65,6 +112,7 @@ domach() {
   asa = osa = use;                      /* default size attributes */
   isegx = isrpx = 0;                    /* nullify instr segment */
   dsrpx = P_DS;                         /* init default segment */
+  mnfirst = YES;                        /* line cache may know it */
   if(gotcolon)                          /* set cp to mnemonic */
        return (donext(skip(2, line)));
   else return (donext(skip(1, line)));
@@ -76,13 +124,23 @@ domach() {
 donext(cp) unsigned char *cp; {
   char mn[MAXNAM+1];
   unsigned dsegx, ssegx, extra, pref, ms, i, j;
-  i = 0;                          /* copy mnemonic for lookup */
-  while(cp[i] > ' ') {
-    if(i < MAXNAM) {mn[i] = toupper(cp[i]); ++i;}
-    else           {synerr(); break;}
+  if(mnfirst && lnrec && (lnrec[LNFLG] & LNFMN))
+    inst[0] = getint(lnrec + LNMN);  /* looked up on pass 1 */
+  else {
+    i = 0;                        /* copy mnemonic for lookup */
+    while(cp[i] > ' ') {
+      if(i < MAXNAM) {mn[i] = toupper(cp[i]); ++i;}
+      else           {synerr(); break;}
+      }
+    mn[i] = 0;
+    inst[0] = find(mn, mntbl, mncnt);
+    if(mnfirst && lnrec && cp[i] <= ' ') {
+      putint(lnrec + LNMN, inst[0]); /* note it for pass 2 */
+      lnrec[LNFLG] |= LNFMN;
+      }
     }
-  mn[i] = 0;
-  if((inst[0] = find(mn, mntbl, mncnt)) == EOF)
+  mnfirst = NO;
+  if(inst[0] == EOF)
     return(NO);                   /* not a machine instruction */
   if(CScheck) {                   /* verify ASSUME CS:<this seg> */
     CScheck = NO;
@@ -109,6 +167,7 @@ donext(cp) unsigned char *cp; {
              &etyp[elast<<2],
              &eflg[elast],
              &endx[elast]);
+        esym[elast] = fwdsym;
         if(endx[elast]                     /* expr has an index */
         && (eflg[elast   ] & FEXT) == 0    /* but not an ext ref */
         && (etyp[elast<<2] & TMEM)) {      /* and mem ref */
@@ -134,7 +193,7 @@ donext(cp) unsigned char *cp; {
 
   Srange = ASOpref = OSOpref = NOPsuff = 0;
   lookups++;
-  if(ms = look(0)) {                  /* lookup instr */
+  if(ms = lookc()) {                  /* lookup instr */
     if(future(ms++)) hdwerr();        /* future hardware? */
     if(pref) switch(mitbuf[ms+1]) {
       case 0x66: osa = (osa == 2) ? 4 : 2; goto xSO; /* OSO */
@@ -163,6 +222,53 @@ donext(cp) unsigned char *cp; {
   return(YES);
   }
 
+/*
+** look for instruction in the look cache, else in M.I.T.
+** return mitbuf[] subscript, else zero
+**
+** Self-relative results depend on operand values, not
+** just types, so they are never cached.
+*/
+lookc() {
+  int ms, *ce;
+  unsigned key1, key2;
+  key1 = rawtyp(0) | (rawtyp(1) << 8);
+  key2 = rawtyp(2) | (osa << 8) | ((elast + 1) << 12);
+  ce = lcache
+     + ((inst[0] + key1 + (key1 >> 5) + key2) & (LCSIZE-1)) * LCENTRY;
+  if(ce[LCMS]
+  && ce[LCMN]   == inst[0]
+  && ce[LCKEY1] == key1
+  && ce[LCKEY2] == key2) {
+    ++lchits;
+    opnds[0] = ce[LCOPND];
+    opnds[1] = ce[LCOPND] >> 8;
+    opnds[2] = ce[LCOPND2];
+    opnds[3] = 0;
+    return (ce[LCMS]);
+    }
+  ++lcmisses;
+  if((ms = look(0))
+  && (opnds[0] & 0xF0) != SELF
+  && !Srange) {
+    ce[LCMN]    = inst[0];
+    ce[LCKEY1]  = key1;
+    ce[LCKEY2]  = key2;
+    ce[LCOPND]  = opnds[0] | (opnds[1] << 8);
+    ce[LCOPND2] = opnds[2];
+    ce[LCMS]    = ms;
+    }
+  return (ms);
+  }
+
+/*
+** raw operand type of expression ex, else zero
+*/
+rawtyp(ex) int ex; {
+  if(ex <= elast) return (etyp[ex<<2] & 0xFF);
+  return (0);
+  }
+
 /*
 ** look for instruction in M.I.T.
 ** return mitbuf[] subscript, else zero
@@ -326,8 +432,11 @@ self(ms) int ms; {
     return (ms);
   NOPsuff = 0;
   if(etyp[0] & TFWD) {                  /* forward reference */
-    if(pass == 1) return (ms);          /* pass 1: take 1st of S8 or S1632 */
-    if(dlen == 1                        /* pass 2: NOPs if near -> short */
+    if(pass == 1                        /* pass 1: take 1st of S8 or S1632 */
+    && (!onepass || esym[0]))           /* single pass: only if undefined */
+      return (ms);
+    if(pass == 2                        /* pass 2: NOPs if near -> short */
+    && dlen == 1
     && (etyp[0] & TSHO) == 0)
       NOPsuff = osa - adj;
     }
@@ -407,16 +516,18 @@ generate(ms) unsigned ms; {
       case I1:   genIMM(0); break;
       case I2:   genIMM(1); break;
       case I3:   genIMM(2); break;
-      case S1:   if((opnds[0] & 0x0F) == 1) {
+      case S1:   if((opnds[0] & 0x0F) == 1 && !esym[0]) {
                    genabs(&eval[0<<3], 1);
                    break;
                    }
-      case O1:   if((eflg[0] & (FDAT|FCOD|FEXT|FSEG|FGRP)) == 0) {
+      case O1:   if((eflg[0] & (FDAT|FCOD|FEXT|FSEG|FGRP)) == 0
+                 && !esym[0]) {
                    genabs(&eval[0<<3], asa);
                    break;
                    }
       case P1:   genrel(0); break;
-      case O2:   if((eflg[1] & (FDAT|FCOD|FEXT|FSEG|FGRP)) == 0) {
+      case O2:   if((eflg[1] & (FDAT|FCOD|FEXT|FSEG|FGRP)) == 0
+                 && !esym[1]) {
                    genabs(&eval[1<<3], asa);
                    break;
                    }
@@ -541,8 +652,8 @@ genModRM(xxx, o) int xxx, o; {
 ** generate immediate value
 */
 genIMM(o) int o; {
-  if(endx[o]) genrel(o);
-  else        genabs(&eval[o<<3], opnds[o] & 0xF);
+  if(endx[o] || esym[o]) genrel(o);
+  else                   genabs(&eval[o<<3], opnds[o] & 0xF);
   }
 
 /*
@@ -554,9 +665,58 @@ genabs(val, sz) int val[], sz; {
     setdata(LEDATA, curuse);
     putLEDATA(val,  sz);           /* gen LEDATA */
     }
+  else if(onepass) logabs(val, sz);
   inc32(loc, sz);                  /* bump location counter */
   }
 
+/*
+** generate rep copies of an sz byte value
+*/
+genrep(rep, val, sz) int rep, val[], sz; {
+  if(pass == 2) {
+    listcode(rep, val, sz, " ", 0);  /* byte or words */
+    setdata(LIDATA, curuse);
+    putLIDATA(rep, val, sz);
+    }
+  else if(onepass) logrep(rep, val, sz);
+  inc32(loc, rep * sz);
+  }
+
+/*
+** hold back an absolute data item, so that a run
+** of repeated values can go out as one LIDATA block
+** (loc moves on at once, so $ stays right)
+*/
+genrun(val, sz) unsigned char *val; int sz; {
+  int i;
+  if(runcnt) {
+    for(i = 0; i < sz; ++i)
+      if(val[i] != runval[i]) {   /* run is broken */
+        endrun(sz);
+        break;
+        }
+    }
+  if(runcnt == 0) {
+    mov32(runloc, loc);
+    for(i = 0; i < sz; ++i) runval[i] = val[i];
+    }
+  ++runcnt;
+  inc32(loc, sz);
+  }
+
+/*
+** generate the held back data items
+*/
+endrun(sz) int sz; {
+  int i;
+  if(runcnt) {
+    mov32(loc, runloc);           /* back to the first item */
+    if(runcnt * sz >= RUNMIN) genrep(runcnt, runval, sz);
+    else for(i = 0; i < runcnt; ++i) genabs(runval, sz);
+    runcnt = 0;
+    }
+  }
+
 /*
 ** generate a relocatable item
 */
@@ -567,7 +727,7 @@ genrel(o) int o; {
   if(len == SELF || len == POINT) len = opnds[o] & 0x0F;
   else if(eflg[o] & FFAR)         len = asa + 2;
   else                            len = asa;
-  if(pass == 2) {
+  if(pass == 2 || onepass) {
     if((opnds[o] & 0xF0) == SELF) {     /* self relative */
       mod  = F_M_SELF;
       lcn  = F_L_OFF;
@@ -614,6 +774,11 @@ genrel(o) int o; {
         }
       }
     fixuse = (use == 2) ? 2 : asa;
+    if(onepass) {                       /* resolve at end */
+      logrel(o, len, fixuse, mod, lcn, fra, fndx, tar, tndx);
+      inc32(loc, len);
+      return;
+      }
     setdata(LEDATA, fixuse);
     putLEDFIX(zero, len, fixuse, mod, lcn, fra, fndx, tar, tndx, tdis);
     if((eflg[o] & (FGRP|FSEG)) || len > asa)
@@ -775,7 +940,8 @@ dosegment() {
   if(badsym) symerr();                 /* symbol error */
   else {
     if(stfind()) {                     /* already in table? */
-      if(flags(stptr) == FCLS)         /* only a class name */
+      if(flags(stptr) == FCLS          /* only a class name */
+      || flags(stptr) == 0)            /* or a single pass fwd ref */
         newseg();                      /* so, make it a segment too */
       if(!(flags(stptr) & FSEG)) {     /* redefinition error */
         rederr();
@@ -1031,6 +1197,7 @@ dodata(sz) int sz; {
     while(*lp != ',' && isgraph(*lp)) {++lp; experr();}  /* trailing junk */
     while(*lp == ',' || isspace(*lp)) {++lp;}
     }
+  endrun(sz);
   } 
 
 /*
@@ -1048,18 +1215,15 @@ dodata2(sz) int sz; {
     doexpr(lp, NO, YES);                /* evaluate count (constant) */
     rep = eval[0<<3];
     lp = dodata3(cp, sz, YES);          /* evaluate data (constant) */
-    if(pass == 2) {
-      listcode(rep, eval, sz, " ", 0);  /* byte or words */
-      setdata(LIDATA, curuse);
-      putLIDATA(rep, eval, sz);
-      }
-    inc32(loc, rep * sz);
+    endrun(sz);
+    genrep(rep, eval, sz);
     return (rep * sz);
     }
 
   nodup:
   pad(eval, 0, 10);
   if((*lp == '\"') || (*lp == '\'')) {  /* string */
+    endrun(sz);
     cnt = 0;
     dlm = *lp;
     while(!atend(*++lp)) {
@@ -1072,9 +1236,13 @@ dodata2(sz) int sz; {
     }
   lp = dodata3(lp, sz, NO);             /* evaluate data */
   opnds[0] = etyp[0<<2];                /* make genrel() see etyp[0] */
-  if(endx[0] == 0)   genabs(eval, sz);  /* generate absolute value */
-  else if(sz == asa) genrel(0);         /* generate relative value */
-  else experr();
+  if(endx[0] == 0 && !esym[0])
+                     genrun(eval, sz);  /* generate absolute value */
+  else {
+    endrun(sz);
+    if(sz == asa)    genrel(0);         /* generate relative value */
+    else experr();
+    }
   return (sz);
   }
 
@@ -1084,8 +1252,8 @@ dodata2(sz) int sz; {
 dodata3(cp, sz, con) char *cp; int sz, con; {
   int bfp;
   bfp = maybe_bfp(cp);            /* 0=>binary, 1=>float, 2=>packed */
+  endx[0] = esym[0] = 0;          /* absolute unless doexpr() says */
   if(bfp == 1 && (sz == 4 || sz == 8 || sz == 10)) {
-    endx[0] = 0;
     cp += atoft(eval, cp);        /* encode as floating point number */
     if(sz < 10) {
       mov80(eval+8, eval);
@@ -1169,15 +1337,14 @@ donamexp(fbit) int fbit; {
     return;
     }
   if(stfind()) {                        /* already defined? */
-    if((flags(stptr) & fbit) == 0) {
+    if(flags(stptr)                     /* not a single pass fwd ref */
+    && (flags(stptr) & fbit) == 0) {
       rederr();
       return;
       }
     }
-  else {                                /* not yet defined  */
-    addsym();
-    setflags(stptr, fbit);
-    }
+  else addsym();                        /* not yet defined  */
+  orflags(stptr, fbit);
   ptr = stptr;                          /* preserve stptr */
   doexpr(lp, YES, NO);                  /* evaluate expression */
   return (ptr);
@@ -1223,6 +1390,7 @@ doexpr(cp, one, con) char *cp;  int one, con; {
   ep = cp;
   seed = M;                      /* avoid residual S8 or S1632 */
   expr(eval, etyp, eflg, endx);
+  esym[0] = fwdsym;
   if((one && atend(*ep) == 0)
   || (con && (etyp[0<<2] & TCON) == 0)) experr();
   return (ep);
@@ -1243,3 +1411,203 @@ setdata(newdata, newuse) int newdata, newuse; {
     }
   }
 
+
+/*****************************************************************
+                    single pass object log
+*****************************************************************/
+
+/*
+** log an absolute value of sz bytes,
+** extending the last record if contiguous
+*/
+logabs(val, sz) unsigned char *val; int sz; {
+  unsigned char *cp;
+  unsigned next[2];
+  if(ollast
+  && ollast[OLKIND] == OLABS
+  && ollast[OLSEG]  == segndx
+  && ollast[OLUSE]  == curuse
+  && ollast[OLLEN] + sz <= 255) {
+    mov32(next, ollast + OLLOC);
+    inc32(next, ollast[OLLEN]);
+    if(cmp32(next, loc) == 0) {
+      logover(sz);
+      ollast[OLLEN] += sz;
+      while(sz--) *olnext++ = *val++;
+      return;
+      }
+    }
+  cp = lognew(OLABS, curuse, sz, OLDATA + sz) + OLDATA;
+  while(sz--) *cp++ = *val++;
+  }
+
+/*
+** log rep copies of an sz byte value
+*/
+logrep(rep, val, sz) unsigned rep; unsigned char *val; int sz; {
+  unsigned char *rp, *cp;
+  rp = lognew(OLREP, curuse, sz, OLITEM + sz);
+  putint(rp + OLCNT, rep);
+  cp = rp + OLITEM;
+  while(sz--) *cp++ = *val++;
+  }
+
+/*
+** log a relocatable item for operand o
+*/
+logrel(o, len, fixuse, mod, lcn, fra, fndx, tar, tndx)
+  int o, len, fixuse, mod, lcn, fra, fndx, tar, tndx; {
+  unsigned char *rp;
+  rp = lognew(OLREL, fixuse, len, OLRELSZ);
+  rp[OLMOD]  = mod;
+  rp[OLLCN]  = lcn;
+  rp[OLFRA]  = fra;
+  rp[OLFNDX] = fndx;
+  rp[OLTAR]  = tar;
+  rp[OLTNDX] = tndx;
+  putint(rp + OLSYM, esym[o]);        /* fwd or ext ref, else zero */
+  mov32(rp + OLVAL, &eval[o<<3]);     /* value or addend */
+  }
+
+/*
+** begin a log record of size bytes
+*/
+lognew(kind, use, len, size) int kind, use, len, size; {
+  unsigned char *rp;
+  logover(size);
+  ollast = rp = olnext;
+  olnext += size;
+  rp[OLKIND] = kind;
+  rp[OLSEG]  = segndx;
+  rp[OLUSE]  = use;
+  rp[OLLEN]  = len;
+  mov32(rp + OLLOC, loc);
+  return (rp);
+  }
+
+/*
+** test for object log overflow
+*/
+logover(size) int size; {
+  if(olnext + size > mtend)
+    error("+ Object Log Overflow, Assemble Without -1");
+  }
+
+/*
+** size of a log record
+*/
+logsize(rp) unsigned char *rp; {
+  switch(rp[OLKIND]) {
+    case OLABS: return (OLDATA + rp[OLLEN]);
+    case OLREP: return (OLITEM + rp[OLLEN]);
+    }
+  return (OLRELSZ);
+  }
+
+/*
+** write the object log as LEDATA, LIDATA, and FIXUPP records
+*/
+replay() {
+  unsigned char *rp;
+  unsigned next[2];
+  segndx = 0;
+  for(rp = olbuf; rp < olnext; rp += logsize(rp)) {
+    poll(YES);
+    if(rp[OLSEG] != segndx             /* new segment */
+    || cmp32(rp + OLLOC, next)) {      /* or ORG moved loc */
+      setdata(0, curuse);              /* end LEDATA or LIDATA */
+      segndx = rp[OLSEG];
+      }
+    mov32(loc, rp + OLLOC);
+    switch(rp[OLKIND]) {
+      case OLABS: setdata(LEDATA, rp[OLUSE]);
+                  putLEDATA(rp + OLDATA, rp[OLLEN]);
+                  inc32(loc, rp[OLLEN]);
+                  break;
+      case OLREP: setdata(LIDATA, rp[OLUSE]);
+                  putLIDATA(getint(rp + OLCNT), rp + OLITEM, rp[OLLEN]);
+                  inc32(loc, getint(rp + OLCNT) * rp[OLLEN]);
+                  break;
+      case OLREL: putrel(rp);
+                  inc32(loc, rp[OLLEN]);
+      }
+    mov32(next, loc);
+    }
+  setdata(0, curuse);
+  }
+
+/*
+** write a logged relocatable item, first resolving
+** any forward or external reference it carries
+*/
+putrel(rp) unsigned char *rp; {
+  unsigned char *sp;
+  int f, fra, fndx, tar, tndx, *tdis, val[2], next[2];
+  fra = rp[OLFRA];  fndx = rp[OLFNDX];
+  tar = rp[OLTAR];  tndx = rp[OLTNDX];
+  mov32(val, rp + OLVAL);
+  setdata(LEDATA, rp[OLUSE]);
+  if(sp = getint(rp + OLSYM)) {
+    if((flags(sp) & FEQU)
+    && val1(sp)) sp = val1(sp);        /* alias */
+    f = flags(sp);
+    if(f & FEXT) {                     /* external */
+      fra  = F_F_EI;
+      tar  = F_T_EID;
+      fndx = tndx = sp[STNDX];         /* assigned by putEXTs() */
+      }
+    else if((f & ~FPUB) == 0) {
+      logerr(sp, "- Undefined Symbol: ");
+      goto skip;
+      }
+    else if((f & (FCOD|FDAT)) == 0) {  /* EQU, segment, or group */
+      logerr(sp, "- Bad Forward Reference: ");
+      goto skip;
+      }
+    else if((f & FFAR) && rp[OLLCN] != F_L_PTR) {
+      logerr(sp, "- Need FAR PTR: ");
+      goto skip;
+      }
+    else {                             /* label or variable */
+      val2(next, sp);
+      add32(val, next);                /* symbol plus addend */
+      if(rp[OLMOD] == F_M_SELF) {      /* self relative, so */
+        if(sp[STNDX] != segndx) {      /* must be local */
+          logerr(sp, "- Segment Error: ");
+          goto skip;
+          }
+        mov32(next, loc);              /* calc displ */
+        inc32(next, rp[OLLEN]);
+        sub32(val, next);
+        if(rp[OLLEN] == 1
+        && (cmp32(val, S8min) < 0
+         || cmp32(val, S8max) > 0)) logerr(sp, "- Range Error: ");
+        putLEDATA(val, rp[OLLEN]);
+        return;
+        }
+      fra  = F_F_SI;
+      tar  = F_T_SID;
+      fndx = tndx = sp[STNDX];
+      }
+    }
+  if(cmp32(val, zero)) tdis = val;
+  else {
+    tdis = 0;
+    tar |= 4;                          /* target index alone */
+    }
+  putLEDFIX(zero, rp[OLLEN], rp[OLUSE], rp[OLMOD], rp[OLLCN],
+            fra, fndx, tar, tndx, tdis);
+  return;
+  skip:
+  putLEDATA(zero, rp[OLLEN]);          /* keep offsets in step */
+  }
+
+/*
+** report an unresolved reference in the object log
+*/
+logerr(sp, msg) char *sp, *msg; {
+  outerr(msg);
+  outerr(symbol(sp));
+  outerr("\n");
+  ++errors;
+  }
@@ -11,11 +11,14 @@
 
 extern unsigned
   asa,  badsym,  debug,  dsrpx,  gotcolon,  gotcomma,  gotnam,
-  isrpx,  osa,  seed,  segndx,  upper,  x86,  zero[];
+  isrpx,  onepass,  osa,  seed,  segndx,  upper,  x86,  zero[];
 
 extern unsigned char
   *ep,  *stptr,  stsym[];
 
+unsigned char
+  *fwdsym;              /* symbol to resolve at end of single pass */
+
 unsigned
   number[5],            /* value of numeric token */
   iloc[5],              /* instruction location, padded with 3 zeroes */
@@ -23,6 +26,8 @@ unsigned
   regcode,              /* register code */
   segover,              /* seg override prefix in expr? */
   brackets,             /* inside brackets */
+  fwdcnt,               /* fwd and ext refs in expr (single pass) */
+  fwdbad,               /* fwd or ext ref badly combined? */
   ct;                   /* current token */
 
 unsigned
@@ -50,11 +55,15 @@ int                     /* operators by precedence level */
 expr(v, t, f, x) unsigned *v, *t, *f, *x; {
   ct =                      /* no current token */
   brackets =                /* not inside brackets */
-  segover = 0;              /* reset seg override flag */
+  segover =                 /* reset seg override flag */
+  fwdcnt =                  /* no fwd or ext refs */
+  fwdbad = 0;
+  fwdsym = 0;
   pad(v, *f=0, 10);         /* default to null expression */
   pad(t, *x=0,  8);
   if(token(EOE)) return;
   if(!level1(v, t, f, x) || ct != EOE)  experr();
+  if(fwdbad || fwdcnt > 1)  experr();   /* can't resolve at end */
   if( segover && !(t[0] & M))  segerr();
   if(!segover && (t[0] & (TMEM|TCON|TIND)) == TCON)
     t[0] = (t[0] & 0xFF00) | ctype(v);
@@ -224,10 +233,13 @@ primary(v, t, f, x) unsigned *v, *t, *f, *x; {
     return (YES);
     }
   if(token(SYM)) {             /***** symbol *****/
-    if(stfind() && flags(stptr) != FPUB) {  /* only pass 2 for fwd ref */
+    if(stfind()                       /* only pass 2 for fwd ref */
+    && (flags(stptr) & ~FPUB)) {      /* (or single pass placeholder) */
       if((flags(stptr) & FEQU)
       && val1(stptr))                 /* alias? */
         stptr = val1(stptr);          /* map to target */
+      if(onepass
+      && (flags(stptr) & FEXT)) fwdref(stptr); /* index set at end */
       val2(v, stptr);                 /* expr value */
       if(*x == 0) *x = stptr[STNDX];  /* expr index (seg/grp/ext) */
       if((*f & FFAR) == 0             /* fwd ref needs FAR PTR? */
@@ -256,13 +268,25 @@ primary(v, t, f, x) unsigned *v, *t, *f, *x; {
       if(seed == M)
            t[0] = TFWD | TMEM | M;
       else t[0] = TFWD | TMEM | S1632;   /* pass 1: assume not short */
-      underr();                          /* error on 2nd pass only */
+      if(onepass) {                      /* resolve at end */
+        if(!stfind()) addsym();          /* placeholder, no flags */
+        fwdref(stptr);
+        }
+      else underr();                     /* error on 2nd pass only */
       }
     return (YES);
     }
   return (NO);
   }
 
+/*
+** note a reference to be resolved at the end of a single pass
+*/
+fwdref(sp) unsigned char *sp; {
+  fwdsym = sp;
+  ++fwdcnt;
+  }
+
 /*
 ** forward reference?
 */
@@ -291,11 +315,19 @@ down(ops, level, v, t, f, x) int *ops, (*level)(), *v, *t, *f, *x; {
 ** binary drop to a lower level
 */
 down2(oper, level, v, t, f, x) int oper, (*level)(), *v, *t, *f, *x; {
-  int ok, vr[5], tr[4], fr, xr;
+  int ok, vr[5], tr[4], fr, xr, fl;
   pad(vr, fr=0, 10);                    /* init subexpression */
   pad(tr, xr=0,  8);
   if(oper == LBR) brackets = YES;
+  fl = fwdcnt;                          /* fwd refs on left */
   ok = (*level)(vr, tr, &fr, &xr);      /* call next level down */
+  if(fwdcnt != fl) {                    /* fwd ref on right */
+    if(oper != PLUS && oper != LBR) fwdbad = YES;
+    }
+  else if(fl) {                         /* fwd ref on left */
+    if((oper != PLUS && oper != MINUS && oper != LBR)
+    || (tr[0] & TMEM)) fwdbad = YES;
+    }
   binary(v, oper, vr);                  /* apply operator */
   *f |= fr;                             /* merge flag bits */
   if(*x == 0) *x = xr;                  /* set seg index */
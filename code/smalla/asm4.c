@@ -7,13 +7,15 @@
 #include "asm.h" 
 
 extern unsigned
-  badsym,  ccnt,  errors,  gotcolon,  lerr,  lin,
-  list,  lline,  loc[],  looks,  lookups,  lpage,
-  part1,  pause,  pass,  stmax,  stn,  *stp,  upper;
+  badsym,  ccnt,  errors,  gotcolon,  lchits,  lcmisses,  lerr,
+  lin,  list,  lline,  loc[],  looks,  lookups,  lpage,  onepass,
+  part1,  pause,  pass,  *sth,  sthmax,  sthslot,  sthval,  stn,
+  *stp,  stpmax,  upper;
 
 extern unsigned char
-  assume[],  line[],  locnull[],  locstr[],  *segptr,
-  srcfn[],  *st,  *stend,  *stptr,  *strnxt,  *strend,  stsym[];
+  assume[],  line[],  locnull[],  locstr[],  ofn[],  *segptr,
+  srcfn[],  *stend,  *stnext,  *stptr,  *strnxt,  *strend,  stsym[],
+  xfn[];
 
 /*****************************************************************
                      listing  functions
@@ -227,6 +229,12 @@ errshow(fd) int fd; {
     fputs(locstr, fd);
     fputs(" looks/search average\n", fd);
     }
+  itou(lchits, locstr, 7);
+  fputs(locstr, fd);
+  fputs(" look cache hits\n", fd);
+  itou(lcmisses, locstr, 7);
+  fputs(locstr, fd);
+  fputs(" look cache misses\n", fd);
 #endif
   }
 
@@ -308,25 +316,92 @@ symhead() {
   }
 
 /*
-** shell sort the symbol table pointers
+** sort stp[l..u] by name with a stable bottom-up merge,
+** using the hash table (no longer needed) as the work area
 */
-symsort(l, u) int l, u; {
-  int gap, i, j, k, jg;
-  gap = (u - l + 1) >> 1;
-  while(gap > 0) {
-    i = gap + l;
-    while(i <= u) {
-      j = i++ - gap;
-      while(j >= l) {
-        jg = j + gap;
-        if(strcmp(symbol(stp[j]), symbol(stp[jg])) <= 0)  break;
-        k = stp[jg];
-        stp[jg] = stp[j];
-        stp[j] = k;
-        j -= gap;
+symsort(l, u) unsigned l, u; {
+  unsigned *from, *to, *tmp, n, w, i, m, h, a, b, k;
+  n = u - l + 1;
+  from = stp + l;
+  to   = sth;
+  for(w = 1; w < n; w <<= 1) {          /* merge runs of w */
+    for(i = 0; i < n; i += w << 1) {
+      if((m = i + w) > n) m = n;
+      if((h = m + w) > n) h = n;
+      a = k = i;
+      b = m;
+      while(a < m && b < h) {           /* left first when equal */
+        if(strcmp(symbol(from[b]), symbol(from[a])) < 0)
+             to[k++] = from[b++];
+        else to[k++] = from[a++];
         }
+      while(a < m) to[k++] = from[a++];
+      while(b < h) to[k++] = from[b++];
       }
-    gap >>= 1;
+    tmp = from;  from = to;  to = tmp;
+    }
+  if(from != stp + l)                   /* result in work area */
+    for(i = 0; i < n; ++i) stp[l + i] = from[i];
+  }
+
+/*
+** write the cross-reference file, one symbol per line:
+** name value size segment attributes
+*/
+symxref() {
+  int fd, i;
+  unsigned char *sp, *cp, *seg[MAXSEG+1], str[48];
+  strcpy(xfn, ofn);
+  strcpy(strchr(xfn, '.'), XRFEXT);
+  if(!(fd = fopen(xfn, "w"))) error2("- Can't Open: ", xfn);
+  pad(seg, 0, (MAXSEG+1) << 1);
+  for(i = 0; i < stn; ++i)              /* index segment names */
+    if(flags(sp = stp[i]) & FSEG) seg[sp[STNDX]] = sp;
+  symsort(0, stn - 1);
+  for(i = 0; i < stn; ++i) {
+    sp = stp[i];
+    fputs(symbol(sp), fd);
+    ltox(sp + STVAL2, str, 9);
+    cp = str;
+    while(*cp == ' ') *cp++ = '0';
+    fputc(' ', fd);  fputs(str, fd);
+    itou(sp[STSIZE], str, 6);
+    left(str);
+    fputc(' ', fd);  fputs(str, fd);
+    if((flags(sp) & (FCOD|FDAT))
+    && (flags(sp) & FEXT) == 0
+    && seg[sp[STNDX]])
+         cp = symbol(seg[sp[STNDX]]);
+    else cp = "-";
+    fputc(' ', fd);  fputs(cp, fd);
+    *str = 0;
+    symattr(str, sp, FSET, "set");
+    symattr(str, sp, FEQU, "equ");
+    symattr(str, sp, FSEG, "seg");
+    symattr(str, sp, FGRP, "grp");
+    symattr(str, sp, FCLS, "cls");
+    symattr(str, sp, FPUB, "pub");
+    symattr(str, sp, FEXT, "ext");
+    symattr(str, sp, FFAR, "far");
+    symattr(str, sp, FPRO, "pro");
+    symattr(str, sp, FCOD, "cod");
+    symattr(str, sp, FDAT, "dat");
+    if(*str == 0) strcpy(str, "-");
+    fputc(' ', fd);  fputs(str, fd);
+    fputc('\n', fd);
+    poll(YES);
+    }
+  if(ferror(fd)) error2("- Error in Cross-Reference File: ", xfn);
+  fclose(fd);
+  }
+
+/*
+** append attribute name to str if sp has flag bit
+*/
+symattr(str, sp, bit, name) char *str, *sp, *name; int bit; {
+  if(flags(sp) & bit) {
+    if(*str) strcat(str, ",");
+    strcat(str, name);
     }
   }
 
@@ -335,37 +410,77 @@ symsort(l, u) int l, u; {
 *****************************************************************/
 
 /*
-** add a new symbol to the symbol table
+** add stsym to the symbol table in the slot
+** where stfind() just failed to find it
 */
 addsym() {
   int *ip;  char *cp;
-  ip = stptr + STSTR;
-  if(*ip)
-    error2("+ Symbol Table Overflow at: ", line);
-  *ip  = strnxt;
+  if(stn >= stpmax) {             /* 3/4 full */
+    stgrow();
+    stfind();                     /* find slot in new table */
+    }
+  if(stnext >= stend) {           /* need another entry chunk */
+    stnext = topmem(STCHUNK*STENTRY);
+    stend  = stnext + STCHUNK*STENTRY;
+    }
+  if(strend - strnxt <= MAXNAM) { /* need another string chunk */
+    strnxt = topmem(STRCHUNK);
+    strend = strnxt + STRCHUNK;
+    }
+  stptr   = stnext;
+  stnext += STENTRY;
+  ip  = stptr + STHASH;
+  *ip = sthval;
+  ip  = stptr + STSTR;
+  *ip = strnxt;
   cp = stsym;
-  while(*strnxt++ = (upper ? toupper(*cp++) : *cp++))
-    if(strnxt >= strend)
-      error2("+ Symbol Buffer Overflow at: ", line);
-  stp[stn++] = stptr;       /* set symbol pointer */
+  while(*strnxt++ = (upper ? toupper(*cp++) : *cp++)) ;
+  sth[sthslot] = stptr;     /* set hash slot */
+  stp[stn++]   = stptr;     /* set symbol pointer */
   }
 
 /*
 ** find stsym in symbol table
-** leave stptr pointing to desired or null entry
+** leave stptr pointing to desired entry, else zero,
+** and sthslot at its slot, else where to add it
 ** return true if found, else false
 */
 stfind() {
-  char *start;
-  stptr = start = st + hash(stsym, stmax) * STENTRY;
-  while(stptr[0] || stptr[1]) {
-    if(strcmp(stsym, symbol(stptr)) == 0)  return (YES);
-    if((stptr += STENTRY) >= stend)  stptr = st;
-    if(stptr == start)  break;
+  unsigned *ip, mask;
+  mask = sthmax - 1;
+  sthslot = (sthval = mithash(stsym)) & mask;
+  while(stptr = sth[sthslot]) {
+    ip = stptr + STHASH;
+    if(*ip == sthval                /* compare names only if */
+    && strcmp(stsym, symbol(stptr)) == 0)  /* full hashes match */
+      return (YES);
+    sthslot = (sthslot + 1) & mask;
     }
   return(NO);
   }
 
+/*
+** double the hash table and stp[], and rehash
+** by the stored hashes (the old ones are abandoned)
+*/
+stgrow() {
+  unsigned *old, *ip, mask, slot, i;
+  old = sth;
+  mask = (sthmax << 1) - 1;
+  sth = topmem(sthmax << 2);
+  for(i = 0; i < sthmax; ++i) {
+    if(ip = old[i]) {
+      slot = ip[STHASH >> 1] & mask;
+      while(sth[slot]) slot = (slot + 1) & mask;
+      sth[slot] = ip;
+      }
+    }
+  sthmax <<= 1;
+  old = stp;
+  stp = topmem((stpmax = sthmax - (sthmax >> 2)) << 1);
+  for(i = 0; i < stn; ++i) stp[i] = old[i];
+  }
+
 /*
 ** Verify new symbol and table it.
 ** Return YES if symbol added (even if
@@ -386,9 +501,10 @@ newsym(must, colon, fbits) int must, colon, fbits; {
     return (NO);
     }
   if(stfind()) {              /* already in table? */
-    if(flags(stptr) == FPUB) ;
+    if((flags(stptr) & ~FPUB) == 0) ; /* PUBLIC or fwd ref only */
     else {
-      if(pass == 1) orflags(stptr, FRED);
+      if(onepass) rederr();
+      else if(pass == 1) orflags(stptr, FRED);
       else if(flags(stptr) & FRED) rederr();
       return (NO);
       }
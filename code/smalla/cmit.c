@@ -26,13 +26,21 @@
 **
 ** NOTE: An OBJ file created by CMIT must be linked into
 **       ASM.EXE.
+**
+** NOTE: mntbl[], optbl[], and mitbl[] are perfect hashed.
+**       Each key's rotate/xor hash modulo the table size
+**       selects a bucket whose displacement is kept in the
+**       link word of that table entry; the hash divided by
+**       the table size plus the displacement selects the
+**       entry.  So ASM finds or rejects any mnemonic,
+**       operand list, or instruction with exactly one look.
 */
 #include <stdio.h>
 #include "asm.h"
 #include "obj2.h"
 #include "notice.h"
 
-#define MNCNT      363          /* nmemonic hash space */
+#define MNCNT      363          /* mnemonic hash space */
 #define OPCNT      107          /* operand hash space */
 #define MICNT      671          /* machine instr hash space */
 #define MITBUFSZ  8200          /* mit buffer space */
@@ -73,7 +81,16 @@ unsigned
   micnt = MICNT,           /* entries in machine instr table */
   mnused,                  /* mnemonic table entries used */
   opused,                  /* operand table entries used */
-  miused;                  /* machine instr table entries used */
+  miused,                  /* machine instr table entries used */
+  mnkey[MNCNT],            /* mnemonic offsets in mitbuf[] */
+  opkey[OPCNT],            /* operand offsets in mitbuf[] */
+  mikey[MICNT],            /* instruction offsets in mitbuf[] */
+  mnslot[MNCNT],           /* mnemonic ordinal -> mntbl[] index */
+  opslot[OPCNT],           /* operand ordinal -> optbl[] index */
+  keyhv[MICNT],            /* full hash value of each key */
+  slot[MICNT],             /* table index assigned to each key */
+  bfirst[MICNT],           /* first key in each hash bucket */
+  bnext[MICNT];            /* next key in same hash bucket */
 unsigned char
   otmap [TYPES+OTPLUS],    /* operand-type mapping table */
                            /* if == 0 skip immediately to next */
@@ -92,6 +109,7 @@ main(argc, argv) int argc, *argv; {
   parms(argc, argv);       /* get run-time parameters */
   setmap();                /* set-up operand mapping table */
   load();                  /* load MIT into internal format */
+  perfect();               /* perfect hash the three tables */
   fprintf(stderr, "\n");
   fprintf(stderr, " mntbl[]: used %5u of %5u dwords\n", mnused, mncnt);
   fprintf(stderr, " optbl[]: used %5u of %5u dwords\n", opused, opcnt);
@@ -104,7 +122,7 @@ main(argc, argv) int argc, *argv; {
     fprintf(stderr, "     instructions: %5u\n", totinstr);
     fprintf(stderr, "            looks: %5u\n", totlooks);
     if(totinstr)
-      fprintf(stderr, "looks/instruction: %5u (3 min)\n", totlooks/totinstr);
+      fprintf(stderr, "looks/instruction: %5u (1 per table)\n", totlooks/totinstr);
     }
   }
 
@@ -143,9 +161,6 @@ parms(argc, argv) int argc, *argv; {
 load() {
   int  fd, i, byte;
   char str[MAXLINE], *cp;
-  for(i = 0; i < MNCNT*2; mntbl[i++] = EOF) ;
-  for(i = 0; i < OPCNT*2; optbl[i++] = EOF) ;
-  for(i = 0; i < MICNT*2; mitbl[i++] = EOF) ;
   fd = fopen(mitfn, "r");                  /* open source file */
   while(fgets(str, MAXLINE, fd)) {         /* fetch next line */
     poll(YES);                             /* permit interruption */
@@ -204,12 +219,14 @@ load() {
 
 /*
 ** stow mnemonic field in mitbuf[]
-** and return with index in ibuf[0]
+** and return with ordinal in ibuf[0]
 */
 stow_mn(str) char *str; {
   char *cp, buf[11];
   get_mn(str, buf, 11);                        /* extract mnemonic */
-  if(find(buf, mntbl, MNCNT) == EOF) {         /* new field */
+  if((ibuf[0] = ordinal(buf, mnkey, mnused)) == EOF) { /* new field */
+    if(mnused >= MNCNT)
+      error2("\n- mntbl[] Overflow on:\n", str);
                                                /* -2 byte */
     if(strncmp(buf, "MOVS", 4) == 0
     || strncmp(buf, "SCAS", 4) == 0
@@ -222,41 +239,37 @@ stow_mn(str) char *str; {
     else if(strncmp(buf, "CALL", 4) == 0) putmit(S1632);  /* call seed */
     else                                  putmit(M);      /* other seed */
 
-    if(!table(mntbl, hash(buf, MNCNT), MNCNT)) /* insert into mntbl[] */
-      error2("\n- mntbl[] Overflow on:\n", str);
-    else ++mnused;
+    ibuf[0] = mnused;
+    mnkey[mnused++] = index;
     cp = buf; while(putmit(*cp++)) ;           /* copy field */
     }
-  if((ibuf[0] = find(buf, mntbl, MNCNT)) == EOF) 
-    error2("\n- Can't Find Mnemonic in:\n", str);
   }
 
 /*
 ** stow encoded operand fields in mitbuf[]
-** and return with index in ibuf[1]
+** and return with ordinal in ibuf[1]
 */
 stow_op(str) char *str; {
   char buf[11];
   int j;
   get_op(str, buf, 11);
-  if(find(buf, optbl, OPCNT) == EOF) {         /* new field */
-    if(!table(optbl, hash(buf, OPCNT), OPCNT)) /* insert into optbl[] */
+  if((ibuf[1] = ordinal(buf, opkey, opused)) == EOF) { /* new field */
+    if(opused >= OPCNT)
       error2("\n- optbl[] Overflow on:\n", str);
-    else ++opused;
+    ibuf[1] = opused;
+    opkey[opused++] = index;
     for(j=0; putmit(buf[j++]); ) ;             /* copy opnd field codes */
     }
-  if((ibuf[1] = find(buf, optbl, OPCNT)) == EOF) 
-    error2("\n- Can't Find Operand in:\n", str);
   }
 
 /*
-** stow instruction (mnemonic/operand index pair) in mitbuf[]
+** stow instruction (mnemonic/operand ordinal pair) in mitbuf[]
+** (perfect() later replaces the ordinals with table indexes)
 */
 stow_mi(str) char *str; {
-  char *cp;  int i;
-  if(!table(mitbl, hashi(ibuf), MICNT))    /* insert into mitbl[] */
+  if(miused >= MICNT)
     error2("\n- mitbl[] Overflow on:\n", str);
-  else ++miused;
+  mikey[miused++] = index;
   putmit(ibuf[0]);                         /* copy instruction */
   putmit(ibuf[0] >> 8);
   putmit(ibuf[1]);
@@ -264,30 +277,97 @@ stow_mi(str) char *str; {
   }
 
 /*
-** put a new entry into a table
-** returns true on success, else false
+** return ordinal of str among the n fields
+** at key[] offsets in mitbuf[], else EOF
+*/
+ordinal(str, key, n) char *str; unsigned key[], n; {
+  unsigned i;
+  for(i = 0; i < n; ++i)
+    if(strcmp(mitbuf + key[i], str) == 0) return (i);
+  return (EOF);
+  }
+
+/*
+** perfect hash mntbl[], optbl[], and mitbl[]
+*/
+perfect() {
+  unsigned i, *ip;
+  for(i = 0; i < mnused; ++i) keyhv[i] = mithash(mitbuf + mnkey[i]);
+  place(mntbl, mnkey, mnused, MNCNT, "mntbl[]");
+  for(i = 0; i < mnused; ++i) mnslot[i] = slot[i];
+  for(i = 0; i < opused; ++i) keyhv[i] = mithash(mitbuf + opkey[i]);
+  place(optbl, opkey, opused, OPCNT, "optbl[]");
+  for(i = 0; i < opused; ++i) opslot[i] = slot[i];
+  for(i = 0; i < miused; ++i) {            /* ordinals -> indexes */
+    ip = mitbuf + mikey[i];
+    ip[0] = mnslot[ip[0]];
+    ip[1] = opslot[ip[1]];
+    keyhv[i] = ip[1] * mncnt + ip[0];      /* same key as hashi() */
+    }
+  place(mitbl, mikey, miused, MICNT, "mitbl[]");
+  }
+
+/*
+** place n keys into tbl[] without collisions
+** largest buckets first, each at the lowest
+** displacement that lands all of its keys in
+** empty entries
 */
-table(tbl, h, cnt) int tbl[]; unsigned h, cnt; {
-  unsigned start, try, end;
-  h <<= 1;                            /* convert to offset */
-  if(tbl[h] == EOF) tbl[h] = index;   /* empty slot */
-  else {                              /* must extend chain */
-    start = try = h;                  /* init circular scan */
-    end   = (cnt - 1) << 1;           /* last slot */
-    while(YES) {
-      try += 2;                       /* next slot */
-      if(try == start) return (NO);   /* back to start? */
-      if(try > end) try = -2;         /* cycle back? */
-      else {
-        if(tbl[try] == EOF) {         /* empty slot? */
-          tbl[try + 0] = index;       /* point into mitbuf[] */
-          tbl[try + 1] = tbl[h + 1];  /* link first in chain */
-          tbl[h   + 1] = try >> 1;
-          break;                      /* exit scan */
-          }
+place(tbl, key, n, cnt, name) unsigned tbl[], key[], n, cnt; char *name; {
+  unsigned b, d, i, s, size, most;
+  for(b = 0; b < cnt; ++b) {
+    tbl[b << 1] = EOF;                 /* empty entry */
+    tbl[(b << 1) + 1] = 0;             /* no displacement */
+    bfirst[b] = EOF;
+    }
+  for(i = 0; i < n; ++i) {             /* chain keys by bucket */
+    b = keyhv[i] % cnt;
+    bnext[i] = bfirst[b];
+    bfirst[b] = i;
+    }
+  most = 0;
+  for(b = 0; b < cnt; ++b)
+    if((size = bsize(b)) > most) most = size;
+  for(size = most; size; --size) {
+    for(b = 0; b < cnt; ++b) {
+      if(bsize(b) != size) continue;
+      poll(YES);                       /* permit interruption */
+      for(d = 0; d < cnt; ++d)
+        if(fits(tbl, b, d, cnt)) break;
+      if(d == cnt)
+        error2("\n- No Perfect Hash, Adjust Size of ", name);
+      tbl[(b << 1) + 1] = d;
+      for(i = bfirst[b]; i != EOF; i = bnext[i]) {
+        s = (keyhv[i] / cnt + d) % cnt;
+        tbl[s << 1] = key[i];          /* point into mitbuf[] */
+        slot[i] = s;
         }
       }
     }
+  }
+
+/*
+** return number of keys in bucket b
+*/
+bsize(b) unsigned b; {
+  unsigned i, size;
+  size = 0;
+  for(i = bfirst[b]; i != EOF; i = bnext[i]) ++size;
+  return (size);
+  }
+
+/*
+** will bucket b fit into empty tbl[] entries
+** at displacement d?
+*/
+fits(tbl, b, d, cnt) unsigned tbl[], b, d, cnt; {
+  unsigned i, j, s;
+  for(i = bfirst[b]; i != EOF; i = bnext[i]) {
+    s = (keyhv[i] / cnt + d) % cnt;
+    if(tbl[s << 1] != EOF) return (NO);
+    for(j = bfirst[b]; j != i; j = bnext[j])
+      if((keyhv[j] / cnt + d) % cnt == s) return (NO);
+    }
   return (YES);
   }
 
@@ -18,6 +18,9 @@
 #define LBPW    2   /* log2(BPW) */
 #endif
 #endif
+#ifdef TGT32
+#define DOSHRT      /* shorts stay 16 bits when ints are 32 */
+#endif
 #define SBPC    1   /* stack bytes per character (1 or BPW?) */
 #define ERRCODE 7   /* op sys return code */
 
@@ -72,6 +75,8 @@
 #define INT     (BPW << 2)
 #define UCHR   ((  1 << 2) + 1)
 #define UINT   ((BPW << 2) + 1)
+#define SHRT    (  2 << 2)  /* same as INT unless TGT32 */
+#define USHRT  ((  2 << 2) + 1)
 #define UNSIGNED             1
 
 /*
@@ -84,6 +89,13 @@
 #define AUTOEXT   4   // function that is not declared but is referenced
 #define STATIC    5   // only visible throughout this file ("internal linkage")
 
+/*
+** flags in the "OFFSET" of a FUNCTION
+*/
+#define FIXARGS   1   // fixed argument list, so no argument count is passed
+#define NOCOUNT   2   // has been called without an argument count
+#define FASTARG   4   // takes its one argument in the primary register
+
 /*
 ** segment types
 */
@@ -127,6 +139,11 @@
 */
 #define STAGESIZE   200
 
+/*
+** entries held back while a function may be a leaf
+*/
+#define LEAFSIZE    256
+
 /*
 ** macro (#define) pool
 */
@@ -283,33 +300,45 @@
 #define SUB1n   104   /* sub n from pr */
 #define SUBbpn  105   /* sub n from mem byte thru sr ptr */
 #define SUBwpn  106   /* sub n from mem word thru sr ptr */
+#define ASL1n   107   /* arith shift left pr by n */
+#define ASR1n   108   /* arith shift right pr by n */
+#define MUL1n   109   /* multiply pr by n (80186 and later) */
+#define PUSHn   110   /* push word of value n (80186 and later) */
+#define LEAVE   111   /* restore SP and BP (RETURN without the RET) */
+#define TAILm   112   /* jump to function thru label (tail call) */
+#define ENTERl  113   /* set leaf function frame pointer on entry */
+#define RETURNl 114   /* return from leaf function */
+#define ENTERf  115   /* load argument of fast function from stack */
+#define CALLf   116   /* call fast function thru label */
+#define TAILf   117   /* jump to fast function thru label (tail call) */
+#define POPs    118   /* pop word into stack frame */
 
 #ifndef DOSHRT
-#define PCODES  107   /* size of code[] */
+#define PCODES  119   /* size of code[] */
 #else
-/* TBD - 120 FJS+ for 16-bit shorts - */
-#define SHRT_   107   /* define shorts (part 1) */	/* prefix */
+/* 120 FJS+ for 16-bit shorts (TGT32) - */
+#define SHRT_   119   /* define shorts (part 1) */	/* prefix */
 
-#define SHRTn   108   /* define short of value n */
-#define SHRTr0  109   /* define r shorts of value 0 */
-#define GETh1m  110   /* get short into pr from mem thru label */
-#define GETh1mu 111   /* get unsigned short into pr from mem thru label */
-#define GETh1p  112   /* get short into pr from mem thru sr ptr */
-#define GETh1pu 113   /* get unsigned short into pr from mem thru sr ptr */
-#define PUThm1  114   /* put pr short in mem thru label */
-#define PUThp1  115   /* put pr short in mem thru sr ptr */
+#define SHRTn   120   /* define short of value n */
+#define SHRTr0  121   /* define r shorts of value 0 */
+#define GETh1m  122   /* get short into pr from mem thru label */
+#define GETh1mu 123   /* get unsigned short into pr from mem thru label */
+#define GETh1p  124   /* get short into pr from mem thru sr ptr */
+#define GETh1pu 125   /* get unsigned short into pr from mem thru sr ptr */
+#define PUThm1  126   /* put pr short in mem thru label */
+#define PUThp1  127   /* put pr short in mem thru sr ptr */
 
 #ifndef OPTSHRT
-#define PCODES  116   /* size of code[] */
+#define PCODES  128   /* size of code[] */
 #else
 		/* optimizer-generated - */
-#define ADDhpn  116   /* add n to mem short thru sr ptr */
-#define DEChp   117   /* dec mem short thru sr ptr */
-#define GETh1s  118   /* get short into pr from stack */
-#define GETh1su 119   /* get unsigned short into pr from stack */
-#define INChp   120   /* inc short in mem thru sr ptr */
-#define SUBhpn  121   /* sub n from mem short thru sr ptr */
+#define ADDhpn  128   /* add n to mem short thru sr ptr */
+#define DEChp   129   /* dec mem short thru sr ptr */
+#define GETh1s  130   /* get short into pr from stack */
+#define GETh1su 131   /* get unsigned short into pr from stack */
+#define INChp   132   /* inc short in mem thru sr ptr */
+#define SUBhpn  133   /* sub n from mem short thru sr ptr */
 
-#define PCODES  122   /* size of code[] */
+#define PCODES  134   /* size of code[] */
 #endif
 #endif
@@ -14,6 +14,12 @@
 int
     nogo,     /* disable goto statements? */
     noloc,    /* disable block locals? */
+    stkaddr,  /* address of a local taken? */
+    stmtpos,  /* call is a whole statement (set by statement, cleared by callfunc) */
+    fastkw,   /* declaration began with _fastcall? */
+    stlist,   /* statement is directly in a block? */
+    popsp,    /* arguments of earlier calls left on the stack? */
+    spbase,   /* csp to restore when they are popped */
     opindex,  /* index to matched operator */
     opsize,   /* size of operator in characters */
     swactive, /* inside a switch? */
@@ -51,6 +57,9 @@ int
     *snext,    /* next addr in stage */
     *stail,    /* last addr of data in stage */
     *slast,    /* last addr in stage */
+    *lbuf,     /* code held back while a function may be a leaf */
+    *lnext,    /* next addr in lbuf, 0 if not holding back */
+    *llast,    /* last addr in lbuf */
     listfp,   /* file pointer to list device */
     lastst,   /* last parsed statement type */
     oldseg;   /* current segment (0, DATASEG, CODESEG) */
@@ -60,6 +69,7 @@ char
     alarm,    /* audible alarm on errors? */
     monitor,  /* monitor function headers? */
     pause,    /* pause for operator on errors? */
+    cpu,      /* target CPU (0 = 8086, 1 = 80186, 2 = 80286) */
     *symtab,   /* symbol table */
     *litq,     /* literal pool */
     *macn,     /* macro name buffer */
@@ -73,6 +83,7 @@ char
     *cptr,     /* work ptrs to any char buffer */
     *cptr2,
     *cptr3,
+    *curfn,    /* function being compiled, else 0 */
     msname[NAMESIZE],   /* macro symbol name */
     ssname[NAMESIZE];   /* global symbol name */
 
@@ -117,6 +128,8 @@ main(int argc, int *argv) {
     pline = calloc(LINESIZE, 1);
     mline = calloc(LINESIZE, 1);
     slast = stage + (STAGESIZE * 2);    /* 118 FJS* pointer arith: 2 was 2 * BPW */
+    lbuf = calloc(LEAFSIZE, 2 * HSTBPW);
+    llast = lbuf + (LEAFSIZE * 2);
     symtab = calloc((NUMLOCS*SYMAVG + NUMGLBS*SYMMAX), 1);
     locptr = STARTLOC;
     glbptr = STARTGLB;
@@ -178,6 +191,7 @@ dostatic() {
 */
 dodeclare(int class) {
     int type;
+    fastkw = amatch("_fastcall", 9);  /* else left for dofunction() */
     type = dotype();
     if (type != 0) {
         declglb(type, class);
@@ -200,11 +214,19 @@ dotype() {
         if (amatch("char", 4)) {
             return UCHR;
         }
+        else if (amatch("short", 5)) {
+            amatch("int", 3);
+            return USHRT;
+        }
         else {
             amatch("int", 3);
             return UINT;
         }
     }
+    else if (amatch("short", 5)) {
+        amatch("int", 3);
+        return SHRT;
+    }
     else if (amatch("int", 3)) {
         return INT;
     }
@@ -247,6 +269,10 @@ declglb(int type, int class) {
             initials(type >> 2, id, dim, class);
         if (id == POINTER)
             addsym(ssname, id, type, BPW, 0, &glbptr, class);
+        else if (id == FUNCTION && fastkw && class == EXTERNAL) {
+            fastextern(ssname);
+            addsym(ssname, id, type, 0, FIXARGS | FASTARG, &glbptr, class);
+        }
         else 
             addsym(ssname, id, type, dim * (type >> 2), 0, &glbptr, class);
         if (match(",") == 0) 
@@ -385,11 +411,14 @@ putmac(char c) {
 ** out of the following text
 */
 dofunction(int class) {
-    int firstType;
+    int firstType, fast;
     char *pGlobal;
     /*int typedargs; */           /* declared arguments have formal types */
+    fast = fastkw || class == STATIC;
+    fastkw = NO;
     nogo = 0;                     /* enable goto statements */
     noloc = 0;                    /* enable block-local declarations */
+    stkaddr = 0;                  /* no local addresses taken */
     lastst = 0;                   /* no statement yet */
     litptr = 0;                   /* clear lit pool */
     litlab = getlabel();          /* label next lit pool */
@@ -418,7 +447,7 @@ dofunction(int class) {
         }
     }
     else {
-        addsym(ssname, FUNCTION, INT, 0, 0, &glbptr, class);
+        pGlobal = addsym(ssname, FUNCTION, INT, 0, 0, &glbptr, class);
     }
     /* 119 FJS* publik was public - */
     publik(FUNCTION, class == GLOBAL); // don't do public if class == STATIC
@@ -430,10 +459,27 @@ dofunction(int class) {
     else {
         doArgsNonTyped();
     }
+    curfn = pGlobal;
+    if (curfn && curfn[IDENT] == FUNCTION
+        && (firstType || argtop == BPW)) /* typed or empty argument list */
+        putint(FIXARGS, curfn + OFFSET, 2);
+    if (fast && firstType && argtop == BPW << 1 && curfn[IDENT] == FUNCTION) {
+        putint(FIXARGS | FASTARG, curfn + OFFSET, 2);
+        fastentry(curfn + NAME, class == GLOBAL);
+        putint(-BPW, STARTLOC + OFFSET, 2);  /* spilled below BP */
+        argtop = BPW;             /* nothing passed on the stack */
+    }
+    else fast = NO;
+    if (optimize && listfp != output)
+        lnext = lbuf;             /* hold back code, may be a leaf */
     gen(ENTER, 0);
+    if (fast)
+        gen(PUSH1, 0);            /* spill the argument */
     statement();
     if (lastst != STRETURN && lastst != STGOTO)
         gen(RETURN, 0);
+    leafend(NO);
+    curfn = 0;
     if (litptr) {
         toseg(DATASEG);
         gen(REFm, litlab);
@@ -441,6 +487,20 @@ dofunction(int class) {
     }
 }
 
+/*
+** the function being compiled reads its argument count,
+** so callers must pass it after all
+*/
+varargs() {
+    if (curfn == 0)
+        return;
+    if (getint(curfn + OFFSET, 2) & FASTARG)
+        error("no argument count in fast function");
+    else if (getint(curfn + OFFSET, 2) & NOCOUNT)
+        warning("earlier calls passed no argument count");
+    putint(0, curfn + OFFSET, 2);
+}
+
 /*
 ** doArgsTyped: interpret a function argument list with declared types.
 ** in type: the type of the first variable in the argument list.
@@ -640,9 +700,15 @@ decl(int type, int arrayid, int *id, int *sz) {
 ** statement parser
 */
 statement() {
-    int type;
+    int type, list;
+    list = stlist;
+    stlist = NO;
     if (ch == 0 && eof) return;
-    else if ((type = dotype()) != 0) {
+    blanks();
+    stmtpos = list && optimize && callstmt();
+    if (stmtpos == NO)       /* else callfunc() may leave its arguments */
+        popargs();           /* pop those of earlier calls */
+    if ((type = dotype()) != 0) {
         declloc(type);
         ns();
     }
@@ -716,6 +782,7 @@ statement() {
         }
         else {
             doexpr(NO);
+            stmtpos = NO;      /* in case no call used it */
             ns();
             lastst = STEXPR;
         }
@@ -758,9 +825,11 @@ char *savloc;
             error("no final }");
             break;
         }
-        else
+        else {
+            stlist = YES;
             statement();     /* do one */
-    
+        }
+    popsp = NO;             /* ADDSP or RETURN below pops those left */
     if (--ncmp               /* close current level */
             && lastst != STRETURN
             && lastst != STGOTO)
@@ -948,13 +1017,73 @@ addlabel(def) int def;
 
 doreturn() {
     int savcsp;
+    savcsp = csp;
     if (endst() == 0)
         doexpr(YES);
-    savcsp = csp;
     gen(RETURN, 0);
     csp = savcsp;
 }
 
+/*
+** true if the statement is a call on its own,
+** not a keyword followed by parentheses
+*/
+callstmt() {
+    if (astreq(lptr, "if", 2) || astreq(lptr, "for", 3)
+            || astreq(lptr, "while", 5) || astreq(lptr, "switch", 6)
+            || astreq(lptr, "return", 6))
+        return 0;
+    return callshape();
+}
+
+/*
+** pop the arguments that callfunc() left on the stack
+*/
+popargs() {
+    if (popsp) {
+        popsp = NO;
+        gen(ADDSP, spbase);
+    }
+}
+
+/*
+** true if the rest of the line is "name(...);"
+*/
+callshape() {
+    char *cp, c;
+    int depth;
+    cp = lptr;
+    if (alpha(*cp) == 0 || astreq(cp, "sizeof", 6))
+        return 0;
+    while (an(*cp))
+        ++cp;
+    if (*cp == ' ')
+        ++cp;
+    if (*cp != '(')
+        return 0;
+    depth = 0;
+    while (c = *cp++) {
+        if (c == '"' || c == 39) {      /* skip string or char constant */
+            while (*cp && *cp != c) {
+                if (*cp == 92 && cp[1])
+                    ++cp;
+                ++cp;
+            }
+            if (*cp)
+                ++cp;
+        }
+        else if (c == '(')
+            ++depth;
+        else if (c == ')' && --depth == 0)
+            break;
+    }
+    if (c == 0)
+        return 0;
+    if (*cp == ' ')
+        ++cp;
+    return (*cp == ';');
+}
+
 dobreak() {
     int *ptr;
     if ((ptr = readwhile(wqptr)) == 0)
@@ -977,6 +1106,8 @@ docont() {
 }
 
 doasm() {
+    leafend(YES);        /* assembly code may use BP */
+    varargs();           /* and CL */
     ccode = 0;           /* mark mode as "asm" */
     while (1) {
         linein();               /* 119 FJS* linein was keyword inline */
@@ -1011,11 +1142,12 @@ doexpr(int use) {
 ** get run options
 */
 ask() {
-    int i;
+    int i, n;
     i = listfp = nxtlab = 0;
     output = stdout;
     optimize = YES;
     alarm = monitor = pause = NO;
+    cpu = 0;
     line = mline;
     while (getarg(++i, line, LINESIZE, argcs, argvs) != EOF) {
         if (line[0] != '-' && line[0] != '/')
@@ -1029,6 +1161,18 @@ ask() {
             optimize = NO;
             continue;
         }
+        if (toupper(line[1]) == 'C' && toupper(line[2]) == 'P' &&
+            toupper(line[3]) == 'U' && line[4] == '=') {
+            n = atoi(line + 5);
+            if (n == 86 || n == 8086) {
+                cpu = 0;
+                continue;
+            }
+            if (n == 186 || n == 286) {
+                cpu = n / 100;
+                continue;
+            }
+        }
         if (line[2] <= ' ') {
             if (toupper(line[1]) == 'A') {
                 alarm = YES;
@@ -1043,7 +1187,8 @@ ask() {
                 continue;
             }
         }
-        fputs("usage: cc [file]... [-m] [-a] [-p] [-l#] [-no]\n", stderr);
+        fputs("usage: cc [file]... [-m] [-a] [-p] [-l#] [-no] [-cpu=#86]\n",
+              stderr);
         abort(ERRCODE);
     }
 }
@@ -548,6 +548,15 @@ error(char msg[]) {
     if (listfp > 0) errout(msg, listfp);
 }
 
+/*
+** report a questionable construct, but carry on
+*/
+warning(char msg[]) {
+    lout(line, stderr);
+    errout(msg, stderr);
+    if (listfp > 0) errout(msg, listfp);
+}
+
 errout(char msg[], int fp) {
     int k;
     k = line + 2;
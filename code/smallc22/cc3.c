@@ -19,7 +19,8 @@ extern char
 *litq, *glbptr, *lptr, ssname[NAMESIZE];
 extern int
 ch, csp, litlab, litptr, nch, op[16], op2[16],
-opindex, opsize, *snext;
+opindex, opsize, *snext, stkaddr,
+stmtpos, popsp, spbase;
 
 /***************** lead-in functions *******************/
 
@@ -289,6 +290,7 @@ level13(int is[]) {
         if (amatch("unsigned", 8))  sz = BPW;
         if (amatch("int", 3))  sz = BPW;
         else if (amatch("char", 4))  sz = 1;
+        else if (amatch("short", 5)) { amatch("int", 3);  sz = 2; }
         if (sz) { if (match("*"))          sz = BPW; }
         else if (symname(sname)
             && ((ptr = findloc(sname)) ||
@@ -309,6 +311,7 @@ level13(int is[]) {
         }
         ptr = is[ST];
         is[TA] = ptr[TYPE];
+        if (ptr[CLASS] == AUTOMATIC) stkaddr = YES;
         if (is[TI]) return 0;
         gen(POINT1m, ptr);
         is[TI] = ptr[TYPE];
@@ -361,14 +364,12 @@ level14(int *is) {
                 if (is2[TC]) {
                     clearstage(before, 0);
                     if (is2[CV]) {             /* only add if non-zero */
-                        if (ptr[TYPE] >> 2 == BPW)
-                            gen(GETw2n, is2[CV] << LBPW);
-                        else gen(GETw2n, is2[CV]);
+                        gen(GETw2n, is2[CV] << lsize(ptr[TYPE]));
                         gen(ADD12, 0);
                     }
                 }
                 else {
-                    if (ptr[TYPE] >> 2 == BPW) gen(DBL1, 0);
+                    dbl(DBL1, lsize(ptr[TYPE]));
                     gen(ADD12, 0);
                 }
                 is[TA] = 0;
@@ -403,7 +404,7 @@ primary(int *is) {
         need(")");
         return k;
     }
-    putint(0, is, 7 << LBPW);         /* clear "is" array */
+    putint(0, is, 7 * HSTBPW);        /* clear "is" array */
     if (symname(sname)) {              /* is legal symbol */
         if (ptr = findloc(sname)) {      /* is local */
             if (ptr[IDENT] == LABEL) {
@@ -415,6 +416,7 @@ primary(int *is) {
             is[TI] = ptr[TYPE];
             if (ptr[IDENT] == ARRAY) {
                 is[TA] = ptr[TYPE];
+                stkaddr = YES;
                 return 0;
             }
             if (ptr[IDENT] == POINTER) {
@@ -457,14 +459,18 @@ experr() {
 }
 
 callfunc(char *ptr) {      /* symbol table entry or 0 */
-    int nargs, konst, val;      /* 119 FJS* konst was const */
+    int nargs, konst, val, stmt, fast;  /* 119 FJS* konst was const */
+    fast = ptr && (getint(ptr + OFFSET, 2) & FASTARG);
+    stmt = stmtpos;
+    stmtpos = NO;                  /* not for calls in the arguments */
     nargs = 0;
     blanks();                      /* already saw open paren */
     while (streq(lptr, ")") == 0) {
         if (endst()) break;
         if (ptr) {
             expression(&konst, &val); /* 119 FJS* konst was const */
-            gen(PUSH1, 0);
+            if (fast == NO)
+                gen(PUSH1, 0);
         }
         else {
             gen(PUSH1, 0);
@@ -475,20 +481,49 @@ callfunc(char *ptr) {      /* symbol table entry or 0 */
         if (match(",") == 0) break;
     }
     need(")");
-    if (streq(ptr + NAME, "CCARGC") == 0) gen(ARGCNTn, nargs >> LBPW);
-    if (ptr) gen(CALLm, ptr);
+    if (fast) {                    /* argument stays in the primary */
+        if (nargs != BPW)
+            error("fast function takes one argument");
+        nargs = 0;
+    }
+    if (ptr && streq(ptr + NAME, "CCARGC"))
+        varargs();                 /* caller reads its count */
+    else if (ptr && (getint(ptr + OFFSET, 2) & FIXARGS))
+        putint(getint(ptr + OFFSET, 2) | NOCOUNT, ptr + OFFSET, 2);
+    else gen(ARGCNTn, nargs >> LBPW);
+    if (fast) gen(CALLf, ptr);
+    else if (ptr) gen(CALLm, ptr);
     else    gen(CALL1, 0);
-    gen(ADDSP, csp + nargs);
+    if (stmt) {                    /* leave the arguments for popargs() */
+        if (popsp == NO) {
+            popsp = YES;
+            spbase = csp + nargs;
+        }
+    }
+    else gen(ADDSP, csp + nargs);
 }
 
 /*
-** true if is2's operand should be doubled
+** number of times is2's operand should be doubled
 */
 dubble(int oper, int is1[], int is2[]) {    /* 119 FJS* dubble was keyword double */
     if ((oper != ADD12 && oper != SUB12)
-        || (is1[TA] >> 2 != BPW)
         || (is2[TA])) return 0;
-    return 1;
+    return lsize(is1[TA]);
+}
+
+/*
+** log2 of the size of an object of the given type
+*/
+lsize(int type) {
+    return (type >> 2) >> 1;          /* 1, 2, 4 bytes give 0, 1, 2 */
+}
+
+/*
+** double the primary or secondary register n times
+*/
+dbl(int pcode, int n) {
+    while (n--) gen(pcode, 0);
 }
 
 step(int oper, int is[], int oper2) {
@@ -503,6 +538,10 @@ store(int is[]) {
     if (is[TI]) {                    /* putstk */
         if (is[TI] >> 2 == 1)
             gen(PUTbp1, 0);
+#ifdef DOSHRT
+        else if (is[TI] >> 2 == 2)
+            gen(PUThp1, 0);
+#endif
         else gen(PUTwp1, 0);
     }
     else {                          /* putmem */
@@ -510,6 +549,11 @@ store(int is[]) {
         if (ptr[IDENT] != POINTER
             && ptr[TYPE] >> 2 == 1)
             gen(PUTbm1, ptr);
+#ifdef DOSHRT
+        else if (ptr[IDENT] != POINTER
+            && ptr[TYPE] >> 2 == 2)
+            gen(PUThm1, ptr);
+#endif
         else gen(PUTwm1, ptr);
     }
 }
@@ -519,6 +563,12 @@ fetch(int is[]) {
     ptr = is[ST];
     if (is[TI]) {                                   /* indirect */
         if (is[TI] >> 2 == BPW)     gen(GETw1p, 0);
+#ifdef DOSHRT
+        else if (is[TI] >> 2 == 2) {
+            if (ptr[TYPE] & UNSIGNED) gen(GETh1pu, 0);
+            else                     gen(GETh1p, 0);
+        }
+#endif
         else {
             if (ptr[TYPE] & UNSIGNED) gen(GETb1pu, 0);
             else                     gen(GETb1p, 0);
@@ -527,6 +577,12 @@ fetch(int is[]) {
     else {                                         /* direct */
         if (ptr[IDENT] == POINTER
             || ptr[TYPE] >> 2 == BPW)  gen(GETw1m, ptr);
+#ifdef DOSHRT
+        else if (ptr[TYPE] >> 2 == 2) {
+            if (ptr[TYPE] & UNSIGNED) gen(GETh1mu, ptr);
+            else                     gen(GETh1m, ptr);
+        }
+#endif
         else {
             if (ptr[TYPE] & UNSIGNED) gen(GETb1mu, ptr);
             else                     gen(GETb1m, ptr);
@@ -751,13 +807,13 @@ down2(int oper, int oper2, int (*level)(), int is[], int is2[]) {
             }
             else {                          /* non-commutative */
                 gen(MOVE21, 0);
-                    gen(GETw1n, is2[CV] << double(oper, is, is2));  /* 119 FJS* dubble was keyword double */
+                    gen(GETw1n, is2[CV] << dubble(oper, is, is2));  /* 119 FJS* dubble was keyword double */
             }
         }
         else {                              /* variable op variable */
             gen(POP2, 0);
-            if (dubble(oper, is, is2)) gen(DBL1, 0);  /* 119 FJS* dubble was keyword double */
-            if (dubble(oper, is2, is)) gen(DBL2, 0);  /* 119 FJS* dubble was keyword double */
+            dbl(DBL1, dubble(oper, is, is2));  /* 119 FJS* dubble was keyword double */
+            dbl(DBL2, dubble(oper, is2, is));  /* 119 FJS* dubble was keyword double */
         }
     }
     if (oper) {
@@ -770,11 +826,11 @@ down2(int oper, int oper2, int (*level)(), int is[], int is2[]) {
         else {                                        /* variable result */
             gen(oper, 0);
             if (oper == SUB12
-                && is[TA] >> 2 == BPW
-                && is2[TA] >> 2 == BPW) { /* difference of two word addresses */
+                && lsize(is[TA])
+                && lsize(is[TA]) == lsize(is2[TA])) { /* difference of two word addresses */
                 gen(SWAP12, 0);
-                gen(GETw1n, 1);
-                gen(ASR12, 0);          /* div by 2 */
+                gen(GETw1n, lsize(is[TA]));
+                gen(ASR12, 0);          /* div by object size */
             }
             is[OP] = oper;            /* identify the operator */
         }
@@ -11,11 +11,11 @@
 /*************************** externals ****************************/
 
 extern char
-*cptr, *macn, *litq, *symtab, optimize, ssname[NAMESIZE];
+*cptr, *macn, *litq, *symtab, optimize, cpu, ssname[NAMESIZE];
 
 extern int
-*stage, litlab, litptr, csp, output, oldseg, usexpr,
-*snext, *stail, *slast;
+argtop, stkaddr, *stage, litlab, litptr, csp, output, oldseg, usexpr,
+*snext, *stail, *slast, *lbuf, *lnext, *llast;
 
 
 /***************** optimizer command definitions ******************/
@@ -199,10 +199,33 @@ seq00[] = { 0,ADD12,MOVE21,0,                       /* ADD21 */
                topop | GETw2s,go | p1,0 },
 
     seq47[] = { 0,SUB1n,0,                              /* rDEC1 or rINC1 ? */
-               ifl | m2,0,ifl | 0,rINC1,neg,0,ifl | p3,rDEC1,0,0 };
+               ifl | m2,0,ifl | 0,rINC1,neg,0,ifl | p3,rDEC1,0,0 },
 
-#define HIGH_SEQ  47
-int seq[HIGH_SEQ + 1];
+    seq48[] = { 0,MOVE21,GETw1n,ASL12,sfree,0,          /* ASL1n */
+               go | p2,ASL1n,gv | m1,0 },
+
+    seq49[] = { 0,MOVE21,GETw1n,ASR12,sfree,0,          /* ASR1n */
+               go | p2,ASR1n,gv | m1,0 },
+
+    seq50[] = { 0,SWAP12,GETw1n,ASR12,sfree,0,          /* ASR1n */
+               go | p2,ASR1n,gv | m1,0 },
+
+                /* 80186 and later only, from here to HIGH_SEQ */
+    seq51[] = { 0,GETw1n,PUSH1,pfree,0,                 /* PUSHn */
+               go | p1,PUSHn,gv | m1,0 },
+
+    seq52[] = { 0,PUSHn,_pop,0,                         /* ... GETw2n */
+               topop | GETw2n,go | p1,0 },
+
+    seq53[] = { 0,GETw2n,MUL12,sfree,0,                 /* MUL1n */
+               go | p1,MUL1n,gv | m1,0 },
+
+    seq54[] = { 0,GETw2n,MUL12u,sfree,0,                /* MUL1n */
+               go | p1,MUL1n,gv | m1,0 };
+
+#define HIGH_SEQ  54
+#define HIGH_8086 50   /* last sequence for the 8086 */
+int seq[HIGH_SEQ + 1], highseq;
 setseq() {
     seq[0] = seq00;  seq[1] = seq01;  seq[2] = seq02;  seq[3] = seq03;
     seq[4] = seq04;  seq[5] = seq05;  seq[6] = seq06;  seq[7] = seq07;
@@ -216,19 +239,33 @@ setseq() {
     seq[36] = seq36;  seq[37] = seq37;  seq[38] = seq38;  seq[39] = seq39;
     seq[40] = seq40;  seq[41] = seq41;  seq[42] = seq42;  seq[43] = seq43;
     seq[44] = seq44;  seq[45] = seq45;  seq[46] = seq46;  seq[47] = seq47;
+    seq[48] = seq48;  seq[49] = seq49;  seq[50] = seq50;  seq[51] = seq51;
+    seq[52] = seq52;  seq[53] = seq53;  seq[54] = seq54;
+#ifndef TGT32
+    highseq = cpu ? HIGH_SEQ : HIGH_8086;
+#else
+    highseq = HIGH_SEQ;
+#endif
 }
 
 /***************** assembly-code strings ******************/
 
 int code[PCODES];
+char *fbase, *lbase;           /* frame base registers, see outcode() */
+int inleaf;                    /* outputting a leaf function? */
 
 /*
 ** First byte contains flag bits indicating:
 **    the value in ax is needed (010) or zapped (020)
 **    the value in bx is needed (001) or zapped (002)
+** TGT32 selects the 80386 strings, where ax and bx mean EAX and EBX.
+** That target is experimental: ylink and the runtime are 16-bit only.
 */
 setcodes() {
     setseq();
+#ifndef TGT32
+    fbase = "BP";
+    lbase = "SI";
     code[ADD12] = "\211ADD AX,BX\n";
     code[ADD1n] = "\010?ADD AX,<n>\n??";
     code[ADD21] = "\211ADD BX,AX\n";
@@ -241,8 +278,11 @@ setcodes() {
     code[ANEG1] = "\010NEG AX\n";
     code[ARGCNTn] = "\000?MOV CL,<n>?XOR CL,CL?\n";
     code[ASL12] = "\011MOV CX,AX\nMOV AX,BX\nSAL AX,CL\n";
+    code[ASL1n] = "\010MOV CL,<n>\nSAL AX,CL\n";
     code[ASR12] = "\011MOV CX,AX\nMOV AX,BX\nSAR AX,CL\n";
+    code[ASR1n] = "\010MOV CL,<n>\nSAR AX,CL\n";
     code[CALL1] = "\010CALL AX\n";
+    code[CALLf] = "\030CALL <f>\n";
     code[CALLm] = "\020CALL <m>\n";
     code[BYTE_] = "\000 DB ";
     code[BYTEn] = "\000 DB <n>\n";
@@ -256,6 +296,8 @@ setcodes() {
     code[DIV12] = "\011CWD\nIDIV BX\n";                 /* see gen() */
     code[DIV12u] = "\011XOR DX,DX\nDIV BX\n";            /* see gen() */
     code[ENTER] = "\100PUSH BP\nMOV BP,SP\n";
+    code[ENTERf] = "\022MOV BX,SP\nMOV AX,2[BX]\n";
+    code[ENTERl] = "\000MOV SI,SP\n";
     code[EQ10f] = "\010OR AX,AX\nJE $+5\nJMP _<n>\n";
     code[EQ12] = "\211CALL __eq\n";
     code[GE10f] = "\010OR AX,AX\nJGE $+5\nJMP _<n>\n";
@@ -265,17 +307,17 @@ setcodes() {
     code[GETb1mu] = "\020MOV AL,<m>\nXOR AH,AH\n";
     code[GETb1p] = "\021MOV AL,?<n>??[BX]\nCBW\n";       /* see gen() */
     code[GETb1pu] = "\021MOV AL,?<n>??[BX]\nXOR AH,AH\n"; /* see gen() */
-    code[GETb1s] = "\020MOV AL,<n>[BP]\nCBW\n";
-    code[GETb1su] = "\020MOV AL,<n>[BP]\nXOR AH,AH\n";
+    code[GETb1s] = "\020MOV AL,<n>[<b>]\nCBW\n";
+    code[GETb1su] = "\020MOV AL,<n>[<b>]\nXOR AH,AH\n";
     code[GETw1m] = "\020MOV AX,<m>\n";
     code[GETw1m_] = "\020MOV AX,<m>";
     code[GETw1n] = "\020?MOV AX,<n>?XOR AX,AX?\n";
     code[GETw1p] = "\021MOV AX,?<n>??[BX]\n";            /* see gen() */
-    code[GETw1s] = "\020MOV AX,<n>[BP]\n";
+    code[GETw1s] = "\020MOV AX,<n>[<b>]\n";
     code[GETw2m] = "\002MOV BX,<m>\n";
     code[GETw2n] = "\002?MOV BX,<n>?XOR BX,BX?\n";
     code[GETw2p] = "\021MOV BX,?<n>??[BX]\n";
-    code[GETw2s] = "\002MOV BX,<n>[BP]\n";
+    code[GETw2s] = "\002MOV BX,<n>[<b>]\n";
     code[GT10f] = "\010OR AX,AX\nJG $+5\nJMP _<n>\n";
     code[GT12] = "\010CALL __gt\n";
     code[GT12u] = "\011CALL __ugt\n";
@@ -287,6 +329,7 @@ setcodes() {
     code[JMPm] = "\000JMP _<n>\n";
     code[LABm] = "\000_<n>:\n";
     code[LE10f] = "\010OR AX,AX\nJLE $+5\nJMP _<n>\n";
+    code[LEAVE] = "\000?MOV SP,BP\n??POP BP\n";
     code[LE12] = "\011CALL __le\n";
     code[LE12u] = "\011CALL __ule\n";
     code[LNEG1] = "\010CALL __lneg\n";
@@ -305,16 +348,17 @@ setcodes() {
     code[PLUSn] = "\000?+<n>??\n";
     code[POINT1l] = "\020MOV AX,OFFSET _<l>+<n>\n";
     code[POINT1m] = "\020MOV AX,OFFSET <m>\n";
-    code[POINT1s] = "\020LEA AX,<n>[BP]\n";
+    code[POINT1s] = "\020LEA AX,<n>[<b>]\n";
     code[POINT2m] = "\002MOV BX,OFFSET <m>\n";
     code[POINT2m_] = "\002MOV BX,OFFSET <m>";
-    code[POINT2s] = "\002LEA BX,<n>[BP]\n";
+    code[POINT2s] = "\002LEA BX,<n>[<b>]\n";
     code[POP2] = "\002POP BX\n";
+    code[POPs] = "\000POP WORD PTR <n>[<b>]\n";
     code[PUSH1] = "\110PUSH AX\n";
     code[PUSH2] = "\101PUSH BX\n";
     code[PUSHm] = "\100PUSH <m>\n";
     code[PUSHp] = "\100PUSH ?<n>??[BX]\n";
-    code[PUSHs] = "\100PUSH ?<n>??[BP]\n";
+    code[PUSHs] = "\100PUSH ?<n>??[<b>]\n";
     code[PUT_m_] = "\000MOV <m>";
     code[PUTbm1] = "\010MOV <m>,AL\n";
     code[PUTbp1] = "\011MOV [BX],AL\n";
@@ -324,6 +368,7 @@ setcodes() {
     code[rDEC2] = "\010#DEC BX\n#";
     code[REFm] = "\000_<n>";
     code[RETURN] = "\000?MOV SP,BP\n??POP BP\nRET\n";
+    code[RETURNl] = "\000RET\n";
     code[rINC1] = "\010#INC AX\n#";
     code[rINC2] = "\010#INC BX\n#";
     code[SUB_m_] = "\000SUB <m>";
@@ -334,7 +379,150 @@ setcodes() {
     code[SWAP12] = "\011XCHG AX,BX\n";
     code[SWAP1s] = "\012POP BX\nXCHG AX,BX\nPUSH BX\n";
     code[SWITCH] = "\012CALL __switch\n";
+    code[TAILf] = "\030JMP <f>\n";
+    code[TAILm] = "\020JMP <m>\n";
     code[XOR12] = "\211XOR AX,BX\n";
+    if (cpu) {                          /* 80186 and later */
+        code[ASL1n] = "\010SAL AX,<n>\n";
+        code[ASR1n] = "\010SAR AX,<n>\n";
+        code[MUL1n] = "\010IMUL AX,AX,<n>\n";
+        code[PUSHn] = "\100PUSH <n>\n";
+        code[RETURN] = "\000?LEAVE\n?POP BP\n?RET\n";
+        code[LEAVE] = "\000?LEAVE\n?POP BP\n?";
+    }
+#else
+    fbase = "EBP";
+    lbase = "ESI";
+    code[ADD12] = "\211ADD EAX,EBX\n";
+    code[ADD1n] = "\010?ADD EAX,<n>\n??";
+    code[ADD21] = "\211ADD EBX,EAX\n";
+    code[ADD2n] = "\010?ADD EBX,<n>\n??";
+    code[ADDbpn] = "\001ADD BYTE PTR [EBX],<n>\n";
+    code[ADDwpn] = "\001ADD DWORD PTR [EBX],<n>\n";
+    code[ADDm_] = "\000ADD <m>";
+    code[ADDSP] = "\000?ADD ESP,<n>\n??";
+    code[AND12] = "\211AND EAX,EBX\n";
+    code[ANEG1] = "\010NEG EAX\n";
+    code[ARGCNTn] = "\000?MOV CL,<n>?XOR CL,CL?\n";
+    code[ASL12] = "\011MOV ECX,EAX\nMOV EAX,EBX\nSAL EAX,CL\n";
+    code[ASL1n] = "\010SAL EAX,<n>\n";
+    code[ASR12] = "\011MOV ECX,EAX\nMOV EAX,EBX\nSAR EAX,CL\n";
+    code[ASR1n] = "\010SAR EAX,<n>\n";
+    code[CALL1] = "\010CALL EAX\n";
+    code[CALLf] = "\030CALL <f>\n";
+    code[CALLm] = "\020CALL <m>\n";
+    code[BYTE_] = "\000 DB ";
+    code[BYTEn] = "\000 DB <n>\n";
+    code[BYTEr0] = "\000 DB <n> DUP(0)\n";
+    code[COM1] = "\010NOT EAX\n";
+    code[COMMAn] = "\000,<n>\n";
+    code[DBL1] = "\010SHL EAX,1\n";
+    code[DBL2] = "\001SHL EBX,1\n";
+    code[DECbp] = "\001DEC BYTE PTR [EBX]\n";
+    code[DECwp] = "\001DEC DWORD PTR [EBX]\n";
+    code[DIV12] = "\011CDQ\nIDIV EBX\n";                /* see gen() */
+    code[DIV12u] = "\011XOR EDX,EDX\nDIV EBX\n";         /* see gen() */
+    code[ENTER] = "\100PUSH EBP\nMOV EBP,ESP\n";
+    code[ENTERf] = "\020MOV EAX,4[ESP]\n";
+    code[ENTERl] = "\000MOV ESI,ESP\n";
+    code[EQ10f] = "\010OR EAX,EAX\nJNE _<n>\n";
+    code[EQ12] = "\211CMP EAX,EBX\nSETE AL\nMOVZX EAX,AL\n";
+    code[GE10f] = "\010OR EAX,EAX\nJL _<n>\n";
+    code[GE12] = "\011CMP EAX,EBX\nSETLE AL\nMOVZX EAX,AL\n";
+    code[GE12u] = "\011CMP EAX,EBX\nSETBE AL\nMOVZX EAX,AL\n";
+    code[GETb1m] = "\020MOVSX EAX,<m>\n";
+    code[GETb1mu] = "\020MOVZX EAX,<m>\n";
+    code[GETb1p] = "\021MOVSX EAX,BYTE PTR ?<n>??[EBX]\n";   /* see gen() */
+    code[GETb1pu] = "\021MOVZX EAX,BYTE PTR ?<n>??[EBX]\n";  /* see gen() */
+    code[GETb1s] = "\020MOVSX EAX,BYTE PTR <n>[<b>]\n";
+    code[GETb1su] = "\020MOVZX EAX,BYTE PTR <n>[<b>]\n";
+    code[GETw1m] = "\020MOV EAX,<m>\n";
+    code[GETw1m_] = "\020MOV EAX,<m>";
+    code[GETw1n] = "\020?MOV EAX,<n>?XOR EAX,EAX?\n";
+    code[GETw1p] = "\021MOV EAX,?<n>??[EBX]\n";          /* see gen() */
+    code[GETw1s] = "\020MOV EAX,<n>[<b>]\n";
+    code[GETw2m] = "\002MOV EBX,<m>\n";
+    code[GETw2n] = "\002?MOV EBX,<n>?XOR EBX,EBX?\n";
+    code[GETw2p] = "\021MOV EBX,?<n>??[EBX]\n";
+    code[GETw2s] = "\002MOV EBX,<n>[<b>]\n";
+    code[GT10f] = "\010OR EAX,EAX\nJLE _<n>\n";
+    code[GT12] = "\011CMP EAX,EBX\nSETL AL\nMOVZX EAX,AL\n";
+    code[GT12u] = "\011CMP EAX,EBX\nSETB AL\nMOVZX EAX,AL\n";
+    code[INCbp] = "\001INC BYTE PTR [EBX]\n";
+    code[INCwp] = "\001INC DWORD PTR [EBX]\n";
+    code[WORD_] = "\000 DD ";
+    code[WORDn] = "\000 DD <n>\n";
+    code[WORDr0] = "\000 DD <n> DUP(0)\n";
+    code[JMPm] = "\000JMP _<n>\n";
+    code[LABm] = "\000_<n>:\n";
+    code[LE10f] = "\010OR EAX,EAX\nJG _<n>\n";
+    code[LEAVE] = "\000?LEAVE\n?POP EBP\n?";
+    code[LE12] = "\011CMP EAX,EBX\nSETGE AL\nMOVZX EAX,AL\n";
+    code[LE12u] = "\011CMP EAX,EBX\nSETAE AL\nMOVZX EAX,AL\n";
+    code[LNEG1] = "\010OR EAX,EAX\nSETE AL\nMOVZX EAX,AL\n";
+    code[LT10f] = "\010OR EAX,EAX\nJGE _<n>\n";
+    code[LT12] = "\011CMP EAX,EBX\nSETG AL\nMOVZX EAX,AL\n";
+    code[LT12u] = "\011CMP EAX,EBX\nSETA AL\nMOVZX EAX,AL\n";
+    code[MOD12] = "\011CDQ\nIDIV EBX\nMOV EAX,EDX\n";     /* see gen() */
+    code[MOD12u] = "\011XOR EDX,EDX\nDIV EBX\nMOV EAX,EDX\n"; /* see gen() */
+    code[MOVE21] = "\012MOV EBX,EAX\n";
+    code[MUL12] = "\211IMUL EAX,EBX\n";
+    code[MUL12u] = "\211IMUL EAX,EBX\n";
+    code[MUL1n] = "\010IMUL EAX,EAX,<n>\n";
+    code[NE10f] = "\010OR EAX,EAX\nJE _<n>\n";
+    code[NE12] = "\211CMP EAX,EBX\nSETNE AL\nMOVZX EAX,AL\n";
+    code[NEARm] = "\000 DD _<n>\n";
+    code[OR12] = "\211OR EAX,EBX\n";
+    code[PLUSn] = "\000?+<n>??\n";
+    code[POINT1l] = "\020MOV EAX,OFFSET _<l>+<n>\n";
+    code[POINT1m] = "\020MOV EAX,OFFSET <m>\n";
+    code[POINT1s] = "\020LEA EAX,<n>[<b>]\n";
+    code[POINT2m] = "\002MOV EBX,OFFSET <m>\n";
+    code[POINT2m_] = "\002MOV EBX,OFFSET <m>";
+    code[POINT2s] = "\002LEA EBX,<n>[<b>]\n";
+    code[POP2] = "\002POP EBX\n";
+    code[POPs] = "\000POP DWORD PTR <n>[<b>]\n";
+    code[PUSH1] = "\110PUSH EAX\n";
+    code[PUSH2] = "\101PUSH EBX\n";
+    code[PUSHm] = "\100PUSH <m>\n";
+    code[PUSHn] = "\100PUSH <n>\n";
+    code[PUSHp] = "\100PUSH DWORD PTR ?<n>??[EBX]\n";
+    code[PUSHs] = "\100PUSH DWORD PTR ?<n>??[<b>]\n";
+    code[PUT_m_] = "\000MOV <m>";
+    code[PUTbm1] = "\010MOV <m>,AL\n";
+    code[PUTbp1] = "\011MOV [EBX],AL\n";
+    code[PUTwm1] = "\010MOV <m>,EAX\n";
+    code[PUTwp1] = "\011MOV [EBX],EAX\n";
+    code[rDEC1] = "\010#DEC EAX\n#";
+    code[rDEC2] = "\010#DEC EBX\n#";
+    code[REFm] = "\000_<n>";
+    code[RETURN] = "\000?LEAVE\n?POP EBP\n?RET\n";
+    code[RETURNl] = "\000RET\n";
+    code[rINC1] = "\010#INC EAX\n#";
+    code[rINC2] = "\010#INC EBX\n#";
+    code[SUB_m_] = "\000SUB <m>";
+    code[SUB12] = "\011SUB EAX,EBX\n";                  /* see gen() */
+    code[SUB1n] = "\010?SUB EAX,<n>\n??";
+    code[SUBbpn] = "\001SUB BYTE PTR [EBX],<n>\n";
+    code[SUBwpn] = "\001SUB DWORD PTR [EBX],<n>\n";
+    code[SWAP12] = "\011XCHG EAX,EBX\n";
+    code[SWAP1s] = "\012POP EBX\nXCHG EAX,EBX\nPUSH EBX\n";
+    code[SWITCH] = "\012CALL __switch\n";
+    code[TAILf] = "\030JMP <f>\n";
+    code[TAILm] = "\020JMP <m>\n";
+    code[XOR12] = "\211XOR EAX,EBX\n";
+#ifdef DOSHRT
+    code[SHRT_] = "\000 DW ";
+    code[SHRTn] = "\000 DW <n>\n";
+    code[SHRTr0] = "\000 DW <n> DUP(0)\n";
+    code[GETh1m] = "\020MOVSX EAX,<m>\n";
+    code[GETh1mu] = "\020MOVZX EAX,<m>\n";
+    code[GETh1p] = "\021MOVSX EAX,WORD PTR ?<n>??[EBX]\n";   /* see gen() */
+    code[GETh1pu] = "\021MOVZX EAX,WORD PTR ?<n>??[EBX]\n";  /* see gen() */
+    code[PUThm1] = "\010MOV <m>,AX\n";
+    code[PUThp1] = "\011MOV [EBX],AX\n";
+#endif
+#endif
 }
 
 /***************** code generation functions *****************/
@@ -344,6 +532,14 @@ setcodes() {
 ** and ensure that the segments appear in the correct order.
 */
 header() {
+#ifndef TGT32
+    if (cpu == 1)
+        outline(".186");
+    else if (cpu == 2)
+        outline(".286");
+#else
+    outline(".386");                 /* segments default to USE32 */
+#endif
     toseg(CODESEG);
     outline("extrn __eq: near");
     outline("extrn __ne: near");
@@ -408,6 +604,10 @@ gen(int pcode, int value) {
         case GETb1pu:
         case GETb1p:
         case GETw1p:
+#ifdef DOSHRT
+        case GETh1pu:
+        case GETh1p:
+#endif
             gen(MOVE21, 0); 
             break;
         case SUB12:
@@ -424,6 +624,7 @@ gen(int pcode, int value) {
             csp += BPW;
             break;
         case ADDSP:
+        case LEAVE:
         case RETURN:
             newcsp = value;
             value -= csp;
@@ -468,7 +669,7 @@ dumpstage() {
         if (optimize) {
         restart:
             i = -1;
-            while (++i <= HIGH_SEQ) if (peep(seq[i])) {
+            while (++i <= highseq) if (peep(seq[i])) {
 #ifdef DISOPT
                 if (isatty(output))
                     fprintf(stderr, "                   optimized %2u\n", i);
@@ -521,6 +722,33 @@ publik(int ident, int isGlobal) { /* 119 FJS* publik was keyword public */
     }
 }
 
+/*
+** define the register entry of a fast function,
+** which follows the stack entry that loads its argument
+*/
+fastentry(char *name, int isGlobal) {
+    gen(ENTERf, 0);
+    if (isGlobal) {
+        outstr("PUBLIC ");
+        outfast(name);
+        newline();
+    }
+    outfast(name);
+    colon();
+    newline();
+}
+
+/*
+** declare the register entry of an external fast function
+*/
+fastextern(char *name) {
+    outstr("EXTRN ");
+    outfast(name);
+    colon();
+    outsize(BPW, FUNCTION);
+    newline();
+}
+
 /*
 ** declare external reference
 */
@@ -544,8 +772,17 @@ outsize(int size, int ident) {
         && ident != POINTER
         && ident != FUNCTION)
         outstr("BYTE");
+#ifdef TGT32
+    else if (size == 2
+        && ident != POINTER
+        && ident != FUNCTION)
+        outstr("WORD");
+    else if (ident != FUNCTION)
+        outstr("DWORD");
+#else
     else if (ident != FUNCTION)
         outstr("WORD");
+#endif
     else
         outstr("NEAR");
 }
@@ -554,7 +791,11 @@ outsize(int size, int ident) {
 ** point to following object(s)
 */
 point() {
+#ifdef TGT32
+    outline(" DD $+4");
+#else
     outline(" DW $+2");
+#endif
 }
 
 /*
@@ -567,6 +808,10 @@ dumplits(int size) {
         poll(1);                     /* allow program interruption */
         if (size == 1)
             gen(BYTE_, NULL);
+#ifdef DOSHRT
+        else if (size == 2)
+            gen(SHRT_, NULL);
+#endif
         else
             gen(WORD_, NULL);
         j = 10;
@@ -589,6 +834,10 @@ dumpzero(int size, int count) {
     if (count > 0) {
         if (size == 1)
             gen(BYTEr0, count);
+#ifdef DOSHRT
+        else if (size == 2)
+            gen(SHRTr0, count);
+#endif
         else
             gen(WORDr0, count);
     }
@@ -715,6 +964,109 @@ getpop(int *next) {
 
 /******************* output functions *********************/
 
+/*
+** release the code held back since ENTER.  A function that
+** declares no locals and calls nothing is a leaf.  It does not
+** save BP, and addresses its arguments through SI instead.
+** If the whole function was held back and no address in its
+** frame was taken, a call just before a return becomes a jump.
+*/
+leafend(int frame) {
+    int *pp, *end, *np, base, tails;
+    if ((end = lnext) == 0)
+        return;
+    lnext = 0;
+    tails = frame == NO && stkaddr == NO;
+    base = NO;
+    pp = lbuf;
+    while (pp < end) {
+        switch (*pp) {
+            case CALLf:
+            case CALLm:
+            case CALL1:
+            case TAILf:
+            case TAILm:
+                frame = YES;
+                break;
+            case ADDSP:
+            case RETURN:
+                if (pp[1]) frame = YES;      /* locals */
+                break;
+            case GETb1s:
+            case GETb1su:
+            case GETw1s:
+            case GETw2s:
+            case POINT1s:
+            case POINT2s:
+            case PUSHs:
+                base = YES;
+        }
+        pp += 2;
+    }
+    inleaf = !frame;
+    pp = lbuf;
+    while (pp < end) {
+        if (frame) {
+            if (tails && (np = tailjump(pp, end))) {
+                pp = np;
+                continue;
+            }
+            outcode(pp[0], pp[1]);
+        }
+        else switch (pp[0]) {
+            case ENTER:
+                if (base) outcode(ENTERl, 0);
+                break;
+            case RETURN:
+                outcode(RETURNl, 0);
+                break;
+            case GETb1s:
+            case GETb1su:
+            case GETw1s:
+            case GETw2s:
+            case POINT1s:
+            case POINT2s:
+            case PUSHs:
+                outcode(pp[0], pp[1] - BPW); /* no BP was pushed */
+                break;
+            default:
+                outcode(pp[0], pp[1]);
+        }
+        pp += 2;
+    }
+    inleaf = NO;
+}
+
+/*
+** replace "call f, pop the stack, return" at pp by a jump to f.
+** What the ADDSP pops, f's arguments on top, is popped over our
+** own arguments instead, so it must fit in them; our caller still
+** pops as many as it pushed.  Returns where to resume in lbuf, or
+** 0 if pp is not such a call.
+*/
+tailjump(int *pp, int *end) {
+    int *np, nargs, offset;
+    if (pp[0] != CALLm && pp[0] != CALLf)
+        return 0;
+    np = pp + 4;
+    if (np >= end || pp[2] != ADDSP || np[0] != RETURN)
+        return 0;                  /* no ADDSP: arguments left unpopped */
+    nargs = pp[3];
+    if (nargs < 0 || nargs > argtop - BPW)
+        return 0;
+    offset = BPW << 1;             /* past the pushed BP and return */
+    while (nargs) {
+        outcode(POPs, offset);
+        offset += BPW;
+        nargs -= BPW;
+    }
+    outcode(LEAVE, np[1]);
+    if (pp[0] == CALLf)
+        outcode(TAILf, pp[1]);
+    else outcode(TAILm, pp[1]);
+    return np + 2;
+}
+
 colon() {
     fputc(':', output);
 }
@@ -729,6 +1081,15 @@ newline() {
 outcode(int pcode, int value) {
     int part, skip, count;
     char *cp, *back;
+    if (lnext) {                   /* holding back a possible leaf */
+        if (lnext < llast) {
+            lnext[0] = pcode;
+            lnext[1] = value;
+            lnext += 2;
+            return;
+        }
+        leafend(YES);              /* too long, give it a frame */
+    }
     part = back = 0;
     skip = NO;
     cp = code[pcode] + 1;          /* skip 1st byte of code string */
@@ -737,8 +1098,10 @@ outcode(int pcode, int value) {
             ++cp;                      /* skip to action code */
             if (skip == NO) switch (*cp) {
             case 'm': outname(value + NAME); break; /* mem ref by label */
+            case 'f': outfast(value + NAME); break; /* fast function entry */
             case 'n': outdec(value);       break; /* numeric constant */
             case 'l': outdec(litlab);      break; /* current literal label */
+            case 'b': outstr(inleaf ? lbase : fbase); break; /* frame base */
             }
             cp += 2;                   /* skip past > */
         }
@@ -769,24 +1132,18 @@ outcode(int pcode, int value) {
 }
 
 outdec(int number) {
-    int k, zs;
-    char c, *q, *r;
-    zs = 0;
-    k = 10000;
+    unsigned n, k;
     if (number < 0) {
         number = -number;
         fputc('-', output);
     }
-    while (k >= 1) {
-        q = 0;
-        r = number;
-        while (r >= k) { ++q; r = r - k; }
-        c = q + '0';
-        if (c != '0' || k == 1 || zs) {
-            zs = 1;
-            fputc(c, output);
-        }
-        number = r;
+    n = number;                 /* unsigned, so -32768 prints right */
+    k = 1;                      /* highest power of ten in n, */
+    while (n / k >= 10)         /* whatever the host int size */
+        k *= 10;
+    while (k) {
+        fputc(n / k + '0', output);
+        n %= k;
         k /= 10;
     }
 }
@@ -801,6 +1158,16 @@ outname(char ptr[]) {
     while (*ptr >= ' ') fputc(*ptr++, output);
 }
 
+/*
+** name of the register entry of a fast function, which differs
+** from outname() so that callers disagreeing on the convention
+** fail to link
+*/
+outfast(char ptr[]) {
+    outstr("@");
+    outstr(ptr);
+}
+
 outstr(char ptr[]) {
     poll(1);           /* allow program interruption */
     while (*ptr >= ' ') fputc(*ptr++, output);
@@ -0,0 +1,36 @@
+@ECHO OFF
+REM Compiles test\tail.c and checks which calls were turned into jumps
+REM at the end of the function. Run from this directory after make.bat;
+REM clean.bat removes the output.
+
+SET BIN=..\bin
+
+ECHO === Compiling test\tail.c ===
+%BIN%\cc test\tail -a >tail.asm
+if errorlevel 1 goto exit
+find "JMP _t0" tail.asm >NUL
+if errorlevel 1 goto fail
+find "JMP _t1" tail.asm >NUL
+if errorlevel 1 goto fail
+find "JMP _t2" tail.asm >NUL
+if errorlevel 1 goto fail
+find "CALL _n1" tail.asm >NUL
+if errorlevel 1 goto fail
+find "CALL _n2" tail.asm >NUL
+if errorlevel 1 goto fail
+find "CALL _n3" tail.asm >NUL
+if errorlevel 1 goto fail
+find "CALL _n4" tail.asm >NUL
+if errorlevel 1 goto fail
+find "CALL _n5" tail.asm >NUL
+if errorlevel 1 goto fail
+find "JMP _n" tail.asm >NUL
+if not errorlevel 1 goto fail
+ECHO === Tail call test passed ===
+goto exit
+
+:fail
+ECHO === Tail call test FAILED, see tail.asm ===
+
+:exit
+@ECHO ON
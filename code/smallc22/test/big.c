@@ -0,0 +1,13 @@
+/*
+** BIG.C -- test32.bat compiles this with the TGT32 compiler and
+** looks for each constant, which must be emitted whole.
+*/
+big() {
+    return 30000;
+}
+
+ten() {
+    return 10000;
+}
+
+int neg = -12345;
@@ -0,0 +1,5 @@
+/*
+** DEF32.C -- compiled ahead of cc1.c..cc4.c by test32.bat,
+** so that they build a compiler for the TGT32 80386 target.
+*/
+#define TGT32
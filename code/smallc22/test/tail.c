@@ -0,0 +1,59 @@
+/*
+** TAIL.C -- tail.bat compiles this and checks that each call to a
+** t function became a jump and each call to an n function did not.
+*/
+int g;
+
+t0() { return 0; }
+t1(int a) { return a; }
+t2(int a, int b) { return a - b; }
+n1(int a) { return a; }
+n2(int a, int b) { return a - b; }
+n3(int a) { return a; }
+n4(int a) { return a; }
+n5(int a) { return a; }
+
+none() {                    /* nothing to pop */
+    return t0();
+}
+
+swap(int a, int b) {        /* as many arguments as we were given */
+    return t2(b, a);
+}
+
+fewer(int a, int b) {       /* fewer, with a local in scope */
+    int c;
+    c = a + b;
+    return t1(c);
+}
+
+more(int a) {               /* more than we were given */
+    return n2(a, a);
+}
+
+later(int a) {              /* address taken after the call */
+    int *p;
+    if (a) return n1(a);
+    p = &a;
+    g = *p;
+    return 0;
+}
+
+array(int a) {              /* local array, so addresses escape */
+    char buf[2];
+    buf[0] = a;
+    return n3(buf[0]);
+}
+
+plus(int a) {               /* call is not the last thing done */
+    return n4(a) + 1;
+}
+
+loop(int a) {               /* backward jump reaches the taken address */
+    int *p;
+    while (1) {
+        if (a) return n5(a);
+        p = &a;
+        g = *p;
+    }
+}
@@ -0,0 +1,45 @@
+@ECHO OFF
+REM Builds the compiler for the TGT32 target (see test\def32.c), compiles
+REM test\big.c with it, and checks the constants in the code it emits.
+REM Run from this directory after make.bat; clean.bat removes the output.
+
+SET BIN=..\bin
+SET LIB=..\smalllib
+
+ECHO === Building TGT32 compiler ===
+%BIN%\cc  test\def32 cc1 -a -p >t32cc1.asm
+if errorlevel 1 goto exit
+%BIN%\asm t32cc1 /p
+if errorlevel 1 goto exit
+%BIN%\cc  test\def32 cc2 -a -p >t32cc2.asm
+if errorlevel 1 goto exit
+%BIN%\asm t32cc2 /p
+if errorlevel 1 goto exit
+%BIN%\cc  test\def32 cc3 -a -p >t32cc3.asm
+if errorlevel 1 goto exit
+%BIN%\asm t32cc3 /p
+if errorlevel 1 goto exit
+%BIN%\cc  test\def32 cc4 -a -p >t32cc4.asm
+if errorlevel 1 goto exit
+%BIN%\asm t32cc4 /p
+if errorlevel 1 goto exit
+%BIN%\ylink t32cc1.obj,t32cc2.obj,t32cc3.obj,t32cc4.obj,%LIB%\clib.lib -e=cc32.exe
+if errorlevel 1 goto exit
+
+ECHO === Compiling test\big.c ===
+cc32 test\big -a >t32big.asm
+if errorlevel 1 goto exit
+find "MOV EAX,30000" t32big.asm >NUL
+if errorlevel 1 goto fail
+find "MOV EAX,10000" t32big.asm >NUL
+if errorlevel 1 goto fail
+find "-12345" t32big.asm >NUL
+if errorlevel 1 goto fail
+ECHO === TGT32 test passed ===
+goto exit
+
+:fail
+ECHO === TGT32 test FAILED, see t32big.asm ===
+
+:exit
+@ECHO ON
@@ -5,3 +5,4 @@
 #define FSIZE  (100*7)                /* fixup buffer size (max*avg) */
 #define OSIZE   1027                  /* obuf[] size - DON'T INCREASE! */
 #define OFREE ((OSIZE - 1) - onext)   /* obuf[] space remaining */
+#define DSLOTS     4                  /* LEDATA records open at once */
@@ -13,39 +13,84 @@
 char *pathOutput; // path to the file used for writing output exe/lib file.
 char *pathDebug; // path to file used for debug output.
 char *pathLibInput; // path to file used as library object file input.
+char *pathMap; // path to file used for the link map.
+char *pathInc; // path to file used for incremental link state.
 uint fdDebug; // fd to which we will output debug information. can be stdout
 // --- DOS exe data -----------------------------------------------------------
-#define EXE_HDR_LEN 512
-#define RELOC_COUNT 8
-#define RELOC_PER 1
+#define EXE_HDR_FIX 0x1E // bytes of exe header before the relocation table.
+#define RELOC_CHUNK 8 // initial size, relocData doubles when full.
+#define RELOC_POS 0 // offset of the segment word in the load image
+#define RELOC_MOD 1 // index of module containing it
+#define RELOC_PER 2
 int *relocData;
-int relocCount;
+int relocCount, relocMax;
 int exeStartAddress;
+// --- Zero fill - DATA past dataInit is left out of the exe file -------------
+#define ZFILL_MIN 64 // omit zero fill only if it saves at least this much.
+#define ZSTUB_LEN 32 // code appended to CODE that clears the omitted DATA.
+#define NO_STUB 0xffff
+uint dataInit; // length of DATA written to the output file.
+uint zeroStub; // offset in CODE of the zero fill stub, or NO_STUB.
+byte stackInit; // if 1, some module puts nonzero data in STACK.
+// --- Incremental link - state saved in pathInc, see IncLink ----------------
+#define INC_MAGIC 0x4c49 // "IL"
+#define INC_VERSION 2
+#define SITE_CHUNK 64 // initial size, siteData doubles when full.
+#define SITE_MOD 0  // index of module containing the fixupp
+#define SITE_POS 1  // offset in output file of the fixed up word
+#define SITE_PBDF 2 // index of the pubdef that the fixupp refers to
+#define SITE_ADD 3  // word written less final address of the pubdef
+#define SITE_PER 4
+int *siteData; // extdef fixupp sites, so that they can be repatched.
+int siteCount, siteMax;
+uint *incFiles; // size and time stamp of each input file at last link.
+// --- DOS com data -----------------------------------------------------------
+#define COM_ORIGIN 0x100 // com images are loaded after the 256-byte PSP.
+#define COM_JMP_LEN 4 // jmp near + nop, if start is not the beginning of CODE.
+byte outCom; // if 1, output is a headerless com image (tiny model).
+uint exeHdrLen; // bytes before CODE in output file: exe header or com jmp.
+uint codeOrigin; // offset of CODE in memory: 0 in exe, after PSP in com.
+uint dataOrigin; // offset of DATA in memory: 0 in exe, after CODE in com.
 // --- 'Line' (variable used when reading strings) ----------------------------
 #define LINEMAX  127
 #define LINESIZE 128
 char *line;
 // --- File paths - these are the files that are read in by the linker --------
-#define FILE_MAX 96
+#define FILE_CHUNK 16 // initial size, filePaths doubles when full.
 int *filePaths; // ptrs to input file paths, including library files.
 int fileCount; // equal to the number of input files.
+int fileMax; // count of entries allocated in filePaths.
 // --- ModData - information about the modules loaded for linking -------------
-#define MOD_MAX 128
+#define MOD_CHUNK 32 // initial size, modData doubles when full.
 #define MDAT_NAM 0
 #define MDAT_CSO 1 // Before P3: code seg length, After P3: code seg origin
 #define MDAT_DSO 2 // Before P3: data seg length, After P3: data seg origin
 #define MDAT_THD 3 // offset to THEADR in file
-#define MDAT_FLG 4 // flags / file offset
-#define MDAT_PER 5
+#define MDAT_FLG 4 // flags
+#define MDAT_FIL 5 // index of file containing this module in filePaths
+#define MDAT_DIL 6 // length of data seg up to the end of its last nonzero
+                   // or fixed up data record. The rest is zero fill.
+#define MDAT_CLN 7 // code seg length
+#define MDAT_DLN 8 // data seg length
+#define MDAT_WHY 9 // lib mods: index of the pubdef that caused inclusion
+#define MDAT_BY 10 // lib mods: index of the mod with the matching extdef
+#define MDAT_CSL 11 // code slot length: code seg length plus room to grow
+#define MDAT_DSL 12 // data slot length: data seg length plus room to grow
+#define MDAT_RLC 13 // most segment relocations the module can need
+#define MDAT_PER 14
 #define FlgInLib 0x0100
 #define FlgStart 0x0200
 #define FlgStack 0x0400
 #define FlgInclude 0x800
 int *modData; // each obj has name ptr, 2 fields for seg
-              // origin, theadr offset in file, and flag.
-              // flag is: 0x00ff file index (max 256 files), and 
-              // 0x0f00 flags: 0x0100 in_lib, 0x0200 start, 0x0400 stack
+              // origin, theadr offset in file, flag, file index,
+              // initialised data length, 2 fields for seg length, and
+              // 2 fields noting why the module was included, and 2
+              // fields for slot length (with room for incremental links).
+              // flag is: 0x0100 in_lib, 0x0200 start, 0x0400 stack,
+              // 0x0800 include
 int modCount; // incremented by 1 for each obj and library module in exe.
+int modMax; // count of entries allocated in modData.
 // --- ListNames - temporary LNAMES data (reloaded for each module) -----------
 #define LNAMES_CNT 4
 #define LNAME_NULL 0xFF
@@ -62,21 +107,45 @@ byte *locNames;
 uint *segLengths; // length of segdefs, index is seg_xxx
 byte *locSegs; // seg_xxxs in this module, in order they were defined
 int segIndex; // index of next segdef that will be defined
+// --- Fixupp Threads (reset for each module) --------------------------------
+#define THRD_CNT 4    // four frame threads and four target threads
+#define THRD_FRM 0    // frame threads: method and index bytes for each
+#define THRD_TGT 8    // target threads: method and index bytes for each
+#define THRD_LEN 16
+#define THRD_UNDEF 0xff // method of a thread that has not been defined
+byte *fixThreads;
 // --- Public Definitions -----------------------------------------------------
-#define PBDF_CNT 640
+#define PBDF_CHUNK 128 // initial size, pbdfData doubles when full.
 #define PBDF_NAME 0   // ptr to name of pubdef
-#define PBDF_WHERE 1  // hi: index of module where it is located
-                      // low: index of segment where it is located
+#define PBDF_SEG 1    // seg_xxx of segment where it is located
 #define PBDF_ADDR 2   // offset in segment (+module origin) where it is located
-#define PBDF_PER 3
+#define PBDF_MOD 3    // index of module where it is located
+#define PBDF_PER 4
 int *pbdfData;
 int pbdfCount;
+int pbdfMax; // count of entries allocated in pbdfData.
+// --- LIDATA buffers --------------------------------------------------------
+#define LIDATA_MAX 1024 // a data record holds at most 1024 bytes.
+#define LIOUT_LEN 512 // expanded LIDATA is collected here, then written.
+byte *liBuffer; // Data Blocks of the LIDATA record being expanded.
+byte *liEnd; // end of Data Blocks in liBuffer.
+byte *liOut; // expanded data not yet written.
+uint liOutNext; // count of bytes in liOut.
 // --- ExtDef buffers ---------------------------------------------------------
 #define EXTBUF_LEN 1536 // these variables serve two different purposes.
 char *extBuffer; // In Pass2, list of all unresolved extdefs; 
-int extCount, extNext; // In Pass4, list of extdefs in this module.
+int extCount, extNext; // In Pass4, count of extdefs in this module.
+int *extFrom; // In Pass2, index of the module that needs each extdef.
+int extMod; // In Pass2, index of the module being read.
 #define NOT_INCLUDED -2 // this extdef is defined but not included
 #define NOT_DEFINED -1 // this extdef is not defined
+// --- Resolved ExtDefs - extdefs of the module being linked in Pass4 ---------
+#define EXTR_CNT 255 // ext index is read as a single byte.
+#define EXTR_SEG 0   // seg_xxx where the matching pubdef is located
+#define EXTR_ADDR 1  // final offset of the pubdef in that segment
+#define EXTR_PBDF 2  // index of the matching pubdef (for names in messages)
+#define EXTR_PER 3
+int *extResolved; // indexed by extdef ordinal - 1.
 
 main(int argc, int *argv) {
   int i;
@@ -84,14 +153,26 @@ main(int argc, int *argv) {
   AllocAll();
   RdArgs(argc, argv);
   Initialize();
-  Pass1();
   if (IsLibrary()) {
+    Pass1();
     Pass2Lib();
   }
   else {
-    Pass2();
-    Pass3();
-    Pass4();
+    if ((pathInc == 0) || (IncLink() == 0)) {
+      Pass1();
+      Pass2();
+      Pass3();
+      if (pathInc != 0) {
+        unlink(pathOutput); // delete
+      }
+      Pass4();
+    }
+    if (pathInc != 0) {
+      IncSave();
+    }
+    if (pathMap != 0) {
+      WriteMap();
+    }
     if (fdDebug != 0xffff) {
       fprintf(fdDebug, "Code: %u b Data: %u b, Stack: %u b\n",
         segLengths[SEG_CODE], segLengths[SEG_DATA], segLengths[SEG_STACK]);
@@ -103,17 +184,31 @@ main(int argc, int *argv) {
 
 AllocAll() {
   line = AllocMem(LINESIZE, 1);
-  filePaths = AllocMem(FILE_MAX, 2);
-  modData = AllocMem(MDAT_PER * MOD_MAX, 2);
+  fileMax = FILE_CHUNK;
+  filePaths = AllocMem(fileMax, 2);
+  modMax = MOD_CHUNK;
+  modData = AllocMem(MDAT_PER * modMax, 2);
   locNames = AllocMem(LNAMES_CNT, 1);
   segLengths = AllocMem(SEGS_CNT, 2);
   locSegs = AllocMem(SEGS_CNT, 1);
-  pbdfData = AllocMem(PBDF_PER * PBDF_CNT, 2);
+  fixThreads = AllocMem(THRD_LEN, 1);
+  pbdfMax = PBDF_CHUNK;
+  pbdfData = AllocMem(PBDF_PER * pbdfMax, 2);
   extBuffer = AllocMem(EXTBUF_LEN, 1);
-  relocData = AllocMem(RELOC_PER * RELOC_COUNT, 2);
+  extFrom = AllocMem(EXTBUF_LEN / 2, 2); // names are at least 2 bytes.
+  extResolved = AllocMem(EXTR_PER * EXTR_CNT, 2);
+  liBuffer = AllocMem(LIDATA_MAX, 1);
+  liOut = AllocMem(LIOUT_LEN, 1);
+  relocMax = RELOC_CHUNK;
+  relocData = AllocMem(RELOC_PER * relocMax, 2);
+  siteMax = SITE_CHUNK;
+  siteData = AllocMem(SITE_PER * siteMax, 2);
   pathOutput = 0;
   pathDebug = 0;
   pathLibInput = 0;
+  pathMap = 0;
+  pathInc = 0;
+  outCom = 0;
   fileCount = 0;
   fdDebug = 0xffff;
 }
@@ -133,7 +228,9 @@ Initialize() {
     pathOutput = AllocMem(8, 1);
     strcpy(pathOutput, "out.exe");
   }
-  unlink(pathOutput); // delete
+  if (pathInc == 0) {
+    unlink(pathOutput); // delete, unless it may be relinked in place.
+  }
   for (i = 0; i < SEGS_CNT; i++) {
     segLengths[i] = 0;
   }
@@ -151,6 +248,9 @@ Initialize() {
       }
       readstr(line, LINEMAX, fd);
       length = strlen(line);
+      if (fileCount == fileMax) {
+        filePaths = GrowMem(filePaths, &fileMax, 2);
+      }
       filePaths[fileCount] = AllocMem(length + 1, 1);
       strcpy(filePaths[fileCount], line);
       fileCount += 1;
@@ -177,12 +277,22 @@ RdArgs(int argc, int *argv) {
         case 'e': // e=output file
           RdArgExe(c+3);
           break;
+        case 'c': // c=output com file
+          RdArgExe(c+3);
+          outCom = 1;
+          break;
         case 'd': // d=debug file
           RdArgDebug(c+3);
           break;
         case 'l': // l=library file with input file list of object files
           RdArgLibrary(c+3);
           break;
+        case 'm': // m=map file
+          RdArgMap(c+3);
+          break;
+        case 'i': // i=incremental link state file
+          RdArgInc(c+3);
+          break;
         default:
           fatalf("Could not parse option %s", c);
           break;
@@ -209,8 +319,8 @@ RdArgs(int argc, int *argv) {
 
 RdArgObj(char *start, char *end) {
   char *path;
-  if (fileCount == FILE_MAX) {
-    fatalf("max of %u input files.", FILE_MAX);
+  if (fileCount == fileMax) {
+    filePaths = GrowMem(filePaths, &fileMax, 2);
   }
   filePaths[fileCount] = AllocMem(end - start + 1, 1);
   path = filePaths[fileCount];
@@ -236,6 +346,16 @@ RdArgLibrary(char *str) {
   strcpy(pathLibInput, str);
 }
 
+RdArgMap(char *str) {
+  pathMap = AllocMem(strlen(str) + 1, 1);
+  strcpy(pathMap, str);
+}
+
+RdArgInc(char *str) {
+  pathInc = AllocMem(strlen(str) + 1, 1);
+  strcpy(pathInc, str);
+}
+
 // ============================================================================
 // === Pass1 ==================================================================
 // ============================================================================
@@ -244,6 +364,8 @@ RdArgLibrary(char *str) {
 // 2. for each segment, get name, create seg def (if necessary), set origins,
 // 3. for each pubdef, add to pubdefs.
 byte libInLib; // if 1, we are reading a library obj.
+byte p1DataSeg; // seg_xxx of the last data record in this module.
+uint p1DataEnd; // offset in its segment of the end of that record.
 
 Pass1() {
   uint i, fd;
@@ -253,6 +375,7 @@ Pass1() {
   }
   modCount = 0;
   pbdfCount = 0;
+  stackInit = 0;
   for (i = 0; i < fileCount; i++) {
     fd = safefopen(filePaths[i], "r");
     if (fdDebug != 0xffff) {
@@ -282,6 +405,7 @@ P1_DoRecord(uint fileIndex, byte recType, uint length, uint fd) {
     case THEADR:
       P1_THEADR(fileIndex, length, fd);
       ResetSegments();
+      p1DataSeg = SEG_NOTPRESENT;
       break;
     case MODEND:
       P1_MODEND(length, fd);
@@ -301,11 +425,15 @@ P1_DoRecord(uint fileIndex, byte recType, uint length, uint fd) {
     case LIBEND:
       P1_LIBEND(length, fd);
       break;
-    case COMMNT:
-    case EXTDEF:
-    case FIXUPP:
     case LEDATA:
     case LIDATA:
+      P1_DATA(recType, length, fd);
+      break;
+    case FIXUPP:
+      P1_FIXUPP(length, fd);
+      break;
+    case COMMNT:
+    case EXTDEF:
     case LIBDEP:
     case LIBEND:
       forward(fd, length);
@@ -333,8 +461,8 @@ P1_DoRecord(uint fileIndex, byte recType, uint length, uint fd) {
 // object module.
 P1_THEADR(uint fileIndex, uint length, uint fd) {
   int i;
-  if (modCount == MOD_MAX) {
-    fatalf("Error: max of %u object modules.", MOD_MAX);
+  if (modCount == modMax) {
+    modData = GrowMem(modData, &modMax, MDAT_PER * 2);
   }
   AddModule(fileIndex, fd);
   read_u8(fd); // checksum. assume correct.
@@ -363,10 +491,12 @@ AddModule(uint fileIndex, uint fd) {
   modData[modCount * MDAT_PER + MDAT_CSO] = 0;
   modData[modCount * MDAT_PER + MDAT_DSO] = 0;
   modData[modCount * MDAT_PER + MDAT_THD] = offset[0];
-  modData[modCount * MDAT_PER + MDAT_FLG] = fileIndex & 0x00ff;
-  if (fileIndex > 0xff) { // sanity
-    fatal("AddModule: MDAT_FLG cannot store file index greater than 255.");
-  }
+  modData[modCount * MDAT_PER + MDAT_FLG] = 0;
+  modData[modCount * MDAT_PER + MDAT_FIL] = fileIndex;
+  modData[modCount * MDAT_PER + MDAT_DIL] = 0;
+  modData[modCount * MDAT_PER + MDAT_RLC] = 0;
+  modData[modCount * MDAT_PER + MDAT_WHY] = NOT_DEFINED;
+  modData[modCount * MDAT_PER + MDAT_BY] = NOT_DEFINED;
   if (libInLib) {
     modData[modCount * MDAT_PER + MDAT_FLG] |= FlgInLib;
   }
@@ -379,6 +509,35 @@ ResetSegments() {
     locSegs[i] = SEG_NOTPRESENT;
   }
   segIndex = 0;
+  // threads are defined anew in each module.
+  for (i = 0; i < THRD_LEN; i += 2) {
+    fixThreads[i] = THRD_UNDEF;
+  }
+}
+
+// 9CH FIXUPP Fixup Record
+// Fixups are applied in pass 4. Here, only the threads are kept, as the
+// start address in MODEND may refer to them. FIXUP subrecords are skipped
+// unchecked, as this may be a library module that is never linked, but
+// segment base references are counted to size the exe header.
+P1_FIXUPP(uint length, uint fd) {
+  byte locat;
+  while (length > 1) {
+    locat = read_u8(fd);
+    length -= 1;
+    if ((locat & 0x80) == 0) {
+      length = rd_fix_thread(length, fd, locat);
+    }
+    else {
+      if ((locat & 0x40) && (((locat & 0x3c) >> 2) == 2)) {
+        modData[modCount * MDAT_PER + MDAT_RLC] += 1;
+      }
+      length = skip_fix(length, fd);
+    }
+  }
+  read_u8(fd); // checksum. assume correct.
+  // the fixed up data record holds an address, even if it was zero.
+  P1_DataInit();
 }
 
 // 8AH MODEND Module End Record
@@ -478,13 +637,13 @@ P1_PUBDEF(uint length, uint fd) {  byte typeindex;
   while (length > 1) {
     int namelen;
     namelen = readstrpre(line, fd);
-    if (pbdfCount >= PBDF_CNT) {
-      fatalf2("Could not add %s to pubdefs, max of %u.", line, PBDF_CNT);
+    if (pbdfCount == pbdfMax) {
+      pbdfData = GrowMem(pbdfData, &pbdfMax, PBDF_PER * 2);
     }
     alreadyDefined = FindPubDef(line, 0);
     if (alreadyDefined != NOT_DEFINED) { // works for included and not included
       int otherMod;
-      otherMod = pbdfData[alreadyDefined * PBDF_PER + PBDF_WHERE] >> 8;
+      otherMod = pbdfData[alreadyDefined * PBDF_PER + PBDF_MOD];
       printf("Duplicate pubdef of '%s' in modules %s and %s.",
         line,
         modData[MDAT_PER * otherMod + MDAT_NAM],
@@ -503,8 +662,8 @@ P1_PUBDEF(uint length, uint fd) {  byte typeindex;
     }
     *pdbfname = 0;
     // set the module data.
-    pbdfData[pbdfCount * PBDF_PER + PBDF_WHERE] = locSegs[basesegment - 1];
-    pbdfData[pbdfCount * PBDF_PER + PBDF_WHERE] |= (modCount << 8);
+    pbdfData[pbdfCount * PBDF_PER + PBDF_SEG] = locSegs[basesegment - 1];
+    pbdfData[pbdfCount * PBDF_PER + PBDF_MOD] = modCount;
     pbdfData[pbdfCount * PBDF_PER + PBDF_ADDR] = puboffset;
     length -= namelen + 3;
     pbdfCount += 1;
@@ -575,6 +734,83 @@ P1_SEGDEF(uint length, uint fd, uint pass1) {
   segIndex += 1;
 }
 
+// A0H LEDATA / A2H LIDATA
+// Pass1 only notes whether a data record holds any nonzero byte. Zero-filled
+// buffers (DB n DUP(0)) that end a module's DATA need not be in the exe file.
+P1_DATA(byte recType, uint length, uint fd) {
+  byte segIdx, nonzero;
+  uint offset, size;
+  length -= 4; // length includes segment type, offset, and checksum
+  segIdx = read_u8(fd);
+  offset = read_u16(fd);
+  if (segIdx == 0 || segIdx > SEGS_CNT) {
+    fatalf("P1_DATA: segType of %u, must be between 1 and 3.", segIdx);
+  }
+  nonzero = 0;
+  if (recType == LEDATA) {
+    size = length;
+    while (length > 0) {
+      if (read_u8(fd) != 0) {
+        nonzero = 1;
+      }
+      length -= 1;
+    }
+  }
+  else {
+    size = 0;
+    while (length > 1) {
+      size += P1_LIBLOCK(fd, &length, &nonzero);
+    }
+  }
+  read_u8(fd); // checksum. assume correct.
+  p1DataSeg = locSegs[segIdx - 1];
+  p1DataEnd = offset + size;
+  if (nonzero) {
+    P1_DataInit();
+  }
+}
+
+// Reads one iterated data block, setting *nonzero if it holds a nonzero byte.
+// Returns the number of bytes the block expands to.
+P1_LIBLOCK(uint fd, uint *length, byte *nonzero) {
+  uint repeat, count, size, i;
+  repeat = read_u16(fd);
+  count = read_u16(fd);
+  *length -= 4;
+  size = 0;
+  if (count == 0) {
+    // content is a 1-byte count followed by count data bytes.
+    size = read_u8(fd);
+    *length -= 1 + size;
+    for (i = 0; i < size; i++) {
+      if (read_u8(fd) != 0) {
+        *nonzero = 1;
+      }
+    }
+  }
+  else {
+    // content is count nested data blocks.
+    while (count-- > 0) {
+      size += P1_LIBLOCK(fd, length, nonzero);
+    }
+  }
+  return repeat * size;
+}
+
+// The last data record must be written to the exe file.
+P1_DataInit() {
+  uint mdatBase;
+  mdatBase = modCount * MDAT_PER;
+  if (p1DataSeg == SEG_DATA) {
+    if (p1DataEnd > modData[mdatBase + MDAT_DIL]) {
+      modData[mdatBase + MDAT_DIL] = p1DataEnd;
+    }
+  }
+  else if (p1DataSeg == SEG_STACK) {
+    stackInit = 1;
+  }
+}
+
 // Note: I've removed code to load library dictionary and dependancy records.
 // The library dictionary contains a reference to every pubdef in every object
 // in the library. The library depndancy lists the internal dependancies
@@ -648,7 +884,7 @@ Pass2() {
       int mdatBase, mdatFile;
       mdatBase = i * MDAT_PER;
       if ((modData[mdatBase + MDAT_FLG] & FlgInclude) == FlgInclude) {
-        mdatFile = modData[mdatBase + MDAT_FLG] & 0x00ff;
+        mdatFile = modData[mdatBase + MDAT_FIL];
         if (fdDebug != 0xffff) {
           fprintf(fdDebug, "%s, ", modData[mdatBase + MDAT_NAM]);
         }
@@ -658,6 +894,7 @@ Pass2() {
         if (bseek(fd, offset, 0) == EOF) {
           fatalf("Could not seek to position %u, file too short.", offset[0]);
         }
+        extMod = i;
         P2_DoMod(fd);
         safefclose(fd);
       }
@@ -722,6 +959,7 @@ P2_EXTDEF(uint length, uint fd) {
     }
     else if (pbdfIdx == NOT_INCLUDED) {
       AddName(line, extBuffer, &extNext, EXTBUF_LEN);
+      extFrom[extCount] = extMod;
       extCount += 1;
     }
   }
@@ -735,8 +973,13 @@ P2_Resolve() {
     extName = GetName(i, extBuffer, EXTBUF_LEN);
     pbdfIdx = FindPubDef(extName, 1);
     if (pbdfIdx >= 0) {
-      modIndex = pbdfData[pbdfIdx * PBDF_PER + PBDF_WHERE] / 256;
-      modData[modIndex * MDAT_PER + MDAT_FLG] |= FlgInclude;
+      modIndex = pbdfData[pbdfIdx * PBDF_PER + PBDF_MOD] * MDAT_PER;
+      if ((modData[modIndex + MDAT_FLG] & FlgInclude) == 0) {
+        // note the first extdef that needs this module, for the map file.
+        modData[modIndex + MDAT_WHY] = pbdfIdx;
+        modData[modIndex + MDAT_BY] = extFrom[i];
+      }
+      modData[modIndex + MDAT_FLG] |= FlgInclude;
     }
     else {
       fatalf("P2_Resolve: Could not resolve pubdef for %s.", extName);
@@ -756,29 +999,119 @@ Pass3() {
   if (fdDebug != 0xffff) {
     fprintf(fdDebug, "Pass 3: Setting segment origins.\n");
   }
+  // modules with initialised data come first in DATA, so that the modules
+  // whose DATA is all zero fill end up last, where P3_ZeroFill can omit it.
+  dataInit = 0;
   for (i = 0; i < modCount; i++) {
     int mdatBase, mdatFile;
     mdatBase = i * MDAT_PER;
     if ((modData[mdatBase + MDAT_FLG] & FlgInclude) == FlgInclude) {
       // set code origin for this segment in this module
       seglen = modData[mdatBase + MDAT_CSO];
+      modData[mdatBase + MDAT_CLN] = seglen;
+      modData[mdatBase + MDAT_CSL] = P3_Slot(seglen);
       modData[mdatBase + MDAT_CSO] = segLengths[SEG_CODE];
-      segLengths[SEG_CODE] += seglen;
-      // set data origin for this segment in this module
-      seglen = modData[mdatBase + MDAT_DSO];
-      modData[mdatBase + MDAT_DSO] = segLengths[SEG_DATA];
-      segLengths[SEG_DATA] += seglen;
+      segLengths[SEG_CODE] += modData[mdatBase + MDAT_CSL];
+      if (modData[mdatBase + MDAT_DIL] != 0) {
+        P3_DataOrigin(mdatBase);
+        dataInit = modData[mdatBase + MDAT_DSO] + modData[mdatBase + MDAT_DIL];
+      }
       if ((modData[mdatBase + MDAT_FLG] & FlgStart) == FlgStart) {
         exeStartAddress += modData[mdatBase + MDAT_CSO];
       }
     }
     AlignSegments(SEG_ALIGNMENT);
   }
+  for (i = 0; i < modCount; i++) {
+    int mdatBase;
+    mdatBase = i * MDAT_PER;
+    if (((modData[mdatBase + MDAT_FLG] & FlgInclude) == FlgInclude) &&
+      (modData[mdatBase + MDAT_DIL] == 0)) {
+      P3_DataOrigin(mdatBase);
+      AlignSegments(SEG_ALIGNMENT);
+    }
+  }
   AlignSegments(16);
+  P3_ZeroFill();
+  P3_SetOrigins();
   if (fdDebug != 0xffff) {
-    fprintf(fdDebug, "  CODE=%x\n  DATA=%x\n", 
+    fprintf(fdDebug, "  CODE=%x\n  DATA=%x (%x in file)\n", 
       segLengths[SEG_CODE],
-      segLengths[SEG_DATA]);
+      segLengths[SEG_DATA], dataInit);
+  }
+}
+
+// set data origin for this segment in this module
+P3_DataOrigin(int mdatBase) {
+  uint seglen;
+  seglen = modData[mdatBase + MDAT_DSO];
+  modData[mdatBase + MDAT_DLN] = seglen;
+  modData[mdatBase + MDAT_DSL] = P3_Slot(seglen);
+  modData[mdatBase + MDAT_DSO] = segLengths[SEG_DATA];
+  segLengths[SEG_DATA] += modData[mdatBase + MDAT_DSL];
+}
+
+// Returns the length of the slot for a segment of seglen bytes. For an
+// incremental link, each slot has room to grow so that an edited module can
+// be relinked in place.
+P3_Slot(uint seglen) {
+  if (pathInc == 0) {
+    return seglen;
+  }
+  return seglen + seglen / 16 + 16;
+}
+
+// DATA past dataInit, and STACK, are zero fill. In an exe they are left out
+// of the file and counted in the header's minimum allocation instead. DOS
+// does not clear that memory, so a stub appended to CODE clears the omitted
+// DATA and then jumps to the start address.
+P3_ZeroFill() {
+  zeroStub = NO_STUB;
+  if (outCom || stackInit || (pathInc != 0) ||
+    (segLengths[SEG_DATA] - dataInit < ZFILL_MIN)) {
+    dataInit = segLengths[SEG_DATA];
+    return;
+  }
+  zeroStub = segLengths[SEG_CODE];
+  segLengths[SEG_CODE] += ZSTUB_LEN;
+  AlignSegments(16);
+}
+
+// Set where CODE begins in the output file, and where CODE and DATA begin in
+// memory. An exe has a header before CODE, and addresses each segment from 0.
+// The header is sized for the segment relocations counted in Pass1.
+// A com image has no header; CODE and DATA share one segment loaded at
+// COM_ORIGIN, preceded by a jump if the start address is not CODE:0000.
+P3_SetOrigins() {
+  uint total[2], i, count;
+  if (outCom == 0) {
+    count = 0;
+    for (i = 0; i < modCount; i++) {
+      if (modData[i * MDAT_PER + MDAT_FLG] & FlgInclude) {
+        count += modData[i * MDAT_PER + MDAT_RLC];
+      }
+    }
+    exeHdrLen = ExeHdrLen(P3_Slot(count));
+    codeOrigin = 0;
+    dataOrigin = 0;
+    return;
+  }
+  if (exeStartAddress == 0xffff) {
+    fatal("No start address specified.");
+  }
+  exeHdrLen = 0;
+  if (exeStartAddress != 0) {
+    exeHdrLen = COM_JMP_LEN;
+  }
+  codeOrigin = COM_ORIGIN + exeHdrLen;
+  dataOrigin = codeOrigin + segLengths[SEG_CODE];
+  total[0] = codeOrigin;
+  total[1] = 0;
+  Add1632(segLengths[SEG_CODE], total);
+  Add1632(segLengths[SEG_DATA], total);
+  Add1632(segLengths[SEG_STACK], total);
+  if ((total[1] != 0) || (total[0] > 0xfffe)) {
+    fatal("Code, data and stack do not fit in one 64kb com segment.");
   }
 }
 
@@ -787,12 +1120,15 @@ Pass3() {
 // ============================================================================
 // In Pass4, we are copying in the DATA from the modules, and handling all
 // FIXUPP records.
+int modLinking; // index of the module being linked, for messages.
+
 Pass4() {
   uint i, fd, outfd, checksum;
   uint modOffset[2]; // offset to object module that we are currently reading
   uint codeBase[2]; // offset to code segment in output file.
   uint dataBase[2]; // offset to data segment in output file.
   relocCount = 0;
+  siteCount = 0;
   puts("  Pass 4");
   if (fdDebug != 0xffff) {
     fprintf(fdDebug, "Pass 4:\n");
@@ -802,7 +1138,8 @@ Pass4() {
     int mdatBase, mdatFile;
     mdatBase = i * MDAT_PER;
     if ((modData[mdatBase + MDAT_FLG] & FlgInclude) == FlgInclude) {
-      mdatFile = modData[mdatBase + MDAT_FLG] & 0x00ff;
+      mdatFile = modData[mdatBase + MDAT_FIL];
+      modLinking = i;
       if (fdDebug != 0xffff) {
         fprintf(fdDebug, "Linking %s (%s) CODE=0x%x DATA=0x%x \n", 
           modData[mdatBase + MDAT_NAM], filePaths[mdatFile],
@@ -816,20 +1153,26 @@ Pass4() {
         fatalf("Could not seek to position %u, file too short.", modOffset[0]);
       }
       // get base code and base data offsets for the output file:
-      codeBase[0] = EXE_HDR_LEN + modData[mdatBase + MDAT_CSO];
+      codeBase[0] = exeHdrLen + modData[mdatBase + MDAT_CSO];
       codeBase[1] = 0;
-      dataBase[0] = EXE_HDR_LEN + segLengths[SEG_CODE];
+      dataBase[0] = exeHdrLen + segLengths[SEG_CODE];
       dataBase[1] = 0;
       Add1632(modData[mdatBase + MDAT_DSO], dataBase);
-      // reset extdef buffer
-      extNext = 0;
+      // reset resolved extdefs
       extCount = 0;
       // do the mod!
       P4_DoMod(fd, outfd, codeBase, dataBase);
       safefclose(fd);
     }
   }
+  if (zeroStub != NO_STUB) {
+    WriteZeroStub(outfd);
+  }
   safefclose(outfd);
+  if (outCom) {
+    WriteComJump();
+    return;
+  }
   WriteExeHeader(0);
   checksum = CalcChecksum();
   WriteExeHeader(checksum);
@@ -857,18 +1200,31 @@ CalcChecksum() {
 WriteExeHeader(uint checksum) {
   uint fd;
   uint beginning[2], totalsize[2];
-  uint blockcount, lastblock, rvSS, i;
+  uint blockcount, lastblock, rvSS, i, minAlloc, startIP;
   fd = safefopen(pathOutput, "r+");
   if (exeStartAddress == 0xffff) {
     fatal("No start address specified.");
   }
+  if (ExeHdrLen(relocCount) > exeHdrLen) {
+    fatalf("WriteExeHeader: %u relocations overflow the header.", relocCount);
+  }
   beginning[0] = beginning[1] = 0;
-  totalsize[0] = totalsize[1] = 0;
-  Add1632(segLengths[0], totalsize);
-  Add1632(segLengths[1], totalsize);
-  Add1632(segLengths[2], totalsize);
+  totalsize[0] = exeHdrLen;
+  totalsize[1] = 0;
+  Add1632(segLengths[SEG_CODE], totalsize);
+  Add1632(dataInit, totalsize);
+  minAlloc = 0;
+  startIP = exeStartAddress;
+  if (zeroStub == NO_STUB) {
+    Add1632(segLengths[SEG_STACK], totalsize);
+  }
+  else {
+    minAlloc = Paras(segLengths[SEG_DATA] - dataInit);
+    minAlloc += Paras(segLengths[SEG_STACK]);
+    startIP = zeroStub;
+  }
   lastblock = totalsize[0] % 512;
-  blockcount = totalsize[1] * 128 + totalsize[0] / 512 + 1;
+  blockcount = totalsize[1] * 128 + totalsize[0] / 512;
   if (lastblock != 0) {
     blockcount += 1;
   }
@@ -877,25 +1233,86 @@ WriteExeHeader(uint checksum) {
   fputs("MZ", fd); // 00: "MZ"
   write_f16(fd, lastblock); // 02: count of bytes in last 512b block
   write_f16(fd, blockcount); // 04: count of 512b blocks in file
-  write_f16(fd, 0x0004); // 06: relocation entry count.
-  write_f16(fd, 0x0020); // 08: size of header in paras (0x20 * 0x10 = 0x200).
-  write_f16(fd, 0x0000); // 0A: paras mem needed
+  write_f16(fd, relocCount); // 06: relocation entry count.
+  write_f16(fd, exeHdrLen / 16); // 08: size of header in paras.
+  write_f16(fd, minAlloc); // 0A: paras mem needed
   write_f16(fd, 0xffff); // 0C: paras mem wanted
   write_f16(fd, rvSS); // 0E: Relative value of the stack segment.
   write_f16(fd, segLengths[SEG_STACK]); // 10: Initial value of the SP register.
   write_f16(fd, checksum); // 12: Word checksum. Does not need to be filled in.
-  write_f16(fd, exeStartAddress); // 14: Initial value of the IP register.
+  write_f16(fd, startIP); // 14: Initial value of the IP register.
   write_f16(fd, 0x0000); // 16: Initial value of the CS register.
-  write_f16(fd, 0x001E); // 18: Offset of the first relocation item in the file.
+  write_f16(fd, EXE_HDR_FIX); // 18: Offset of the first relocation item.
   write_f16(fd, 0x0000); // 1A: Overlay number. 0x0000 = main program.
   write_f16(fd, 0x0001); // 1C: ??? Not in spec, but always 0x0001.
   for (i = 0; i < relocCount; i++) {
-    write_f16(fd, relocData[i]);
+    write_f16(fd, relocData[i * RELOC_PER + RELOC_POS]);
     write_f16(fd, 0x0000);
   }
   safefclose(fd);
 }
 
+// Returns the length of an exe header with room for count relocations.
+ExeHdrLen(uint count) {
+  return Paras(EXE_HDR_FIX + count * 4) * 16;
+}
+
+Paras(uint bytes) {
+  if (bytes % 16) {
+    return bytes / 16 + 1;
+  }
+  return bytes / 16;
+}
+
+// The zero fill stub is the entry point of the exe. On entry, es = psp and
+// all other registers except cs:ip and ss:sp must be preserved for the start
+// code. DATA follows CODE, so its paragraph is cs + CODE length / 16.
+WriteZeroStub(uint outfd) {
+  uint stubAddr[2];
+  stubAddr[0] = zeroStub;
+  stubAddr[1] = 0;
+  Add1632(exeHdrLen, stubAddr);
+  bseek(outfd, stubAddr, 0);
+  write_f8(outfd, 0x50); // push ax
+  write_f8(outfd, 0x51); // push cx
+  write_f8(outfd, 0x57); // push di
+  write_f8(outfd, 0x06); // push es
+  write_f16(outfd, 0xc88c); // mov ax,cs
+  write_f8(outfd, 0x05); // add ax,DATA paragraph
+  write_f16(outfd, segLengths[SEG_CODE] / 16);
+  write_f16(outfd, 0xc08e); // mov es,ax
+  write_f8(outfd, 0xbf); // mov di,dataInit
+  write_f16(outfd, dataInit);
+  write_f8(outfd, 0xb9); // mov cx,length of zero fill
+  write_f16(outfd, segLengths[SEG_DATA] - dataInit);
+  write_f16(outfd, 0xc031); // xor ax,ax
+  write_f8(outfd, 0xfc); // cld
+  write_f16(outfd, 0xaaf3); // rep stosb
+  write_f8(outfd, 0x07); // pop es
+  write_f8(outfd, 0x5f); // pop di
+  write_f8(outfd, 0x59); // pop cx
+  write_f8(outfd, 0x58); // pop ax
+  write_f8(outfd, 0xe9); // jmp near, relative to the following instruction.
+  write_f16(outfd, exeStartAddress - (zeroStub + 29));
+}
+
+// A com image begins executing at its first byte. If the start address is not
+// the beginning of CODE, P3_SetOrigins left room for a jump to it.
+WriteComJump() {
+  uint fd;
+  uint beginning[2];
+  if (exeHdrLen == 0) {
+    return;
+  }
+  fd = safefopen(pathOutput, "r+");
+  beginning[0] = beginning[1] = 0;
+  bseek(fd, beginning, 0);
+  write_f8(fd, 0xe9); // jmp near, relative to the following instruction.
+  write_f16(fd, codeOrigin + exeStartAddress - (COM_ORIGIN + 3));
+  write_f8(fd, 0x90); // nop, keeps CODE word aligned.
+  safefclose(fd);
+}
+
 P4_DoMod(uint fd, uint outfd, uint codeBase[], uint dataBase[]) {
   uint length, segOffset;
   byte recType, segType;
@@ -916,7 +1333,7 @@ P4_DoMod(uint fd, uint outfd, uint codeBase[], uint dataBase[]) {
         P1_SEGDEF(length, fd, 0);
         break;
       case EXTDEF:
-        // read into buffer
+        // resolve into extResolved
         P4_EXTDEF(length, fd);
         break;
       case LEDATA:
@@ -944,11 +1361,14 @@ P4_DoMod(uint fd, uint outfd, uint codeBase[], uint dataBase[]) {
   }
 }
 
-// Read all the extdefs for this module into a buffer.
-// extdef names are null-terminated.
+// Resolve each extdef for this module once, when it is read. Pass3 has set
+// the module origins, so the final address of the matching pubdef is known
+// here, and P4_FixExt can index extResolved by ext index without any name
+// lookups.
 P4_EXTDEF(uint length, uint fd) {
   byte deftype;
-  uint strlength;
+  uint strlength, segOfExt, addrOfExt;
+  int pbdfIndex, modOrigin, extBase;
   if (fdDebug != 0xffff) {
     fprintf(fdDebug, "  EXTDEF\n");
   }
@@ -956,7 +1376,31 @@ P4_EXTDEF(uint length, uint fd) {
     strlength = readstrpre(line, fd);
     deftype = read_u8(fd);
     length -= (strlength + 1);
-    AddName(line, extBuffer, &extNext, EXTBUF_LEN);
+    if (extCount == EXTR_CNT) {
+      fatalf("P4_EXTDEF: max of %u extdefs per module.", EXTR_CNT);
+    }
+    pbdfIndex = FindPubDef(line, 0);
+    if (pbdfIndex == NOT_DEFINED) {
+      fatalf("P4_EXTDEF: No pubdef defined matching extdef %s.", line);
+    }
+    else if (pbdfIndex == NOT_INCLUDED) {
+      // this can probably be removed - would error out in P2.
+      fatalf("P4_EXTDEF: Unincluded pubdef matches %s.", line);
+    }
+    segOfExt = pbdfData[pbdfIndex * PBDF_PER + PBDF_SEG];
+    modOrigin = pbdfData[pbdfIndex * PBDF_PER + PBDF_MOD] * MDAT_PER;
+    addrOfExt = pbdfData[pbdfIndex * PBDF_PER + PBDF_ADDR];
+    // other segments are only an error if a fixupp refers to them.
+    if (segOfExt == SEG_CODE) {
+      addrOfExt += modData[modOrigin + MDAT_CSO];
+    }
+    else if (segOfExt == SEG_DATA) {
+      addrOfExt += modData[modOrigin + MDAT_DSO];
+    }
+    extBase = extCount * EXTR_PER;
+    extResolved[extBase + EXTR_SEG] = segOfExt;
+    extResolved[extBase + EXTR_ADDR] = addrOfExt;
+    extResolved[extBase + EXTR_PBDF] = pbdfIndex;
     extCount += 1;
   }
   read_u8(fd); // checksum. assume correct.
@@ -977,6 +1421,10 @@ P4_LEDATA(uint length, uint fd, uint outfd, uint codeBase[], uint dataBase[],
     fatalf("P4_LEDATA: segType of %u, must be between 1 and 3.", *segType);
   }
   *segType = locSegs[*segType - 1]; // transform to local segment index.
+  if (P4_IsZeroFill(*segType, *segOffset, dataBase)) {
+    forward(fd, length + 1); // skip data and checksum.
+    return;
+  }
   P4_SetBase(*segType, codeBase, dataBase, segBase);
   Add1632(*segOffset, segBase); // segBase[0] += *segOffset;
   bseek(outfd, segBase, 0);
@@ -986,6 +1434,25 @@ P4_LEDATA(uint length, uint fd, uint outfd, uint codeBase[], uint dataBase[],
   read_u8(fd); // checksum. assume correct.
 }
 
+// Returns 1 if a data record at segOffset lies in zero fill that P3_ZeroFill
+// left out of the file. Pass1 found such records hold only zeroes.
+P4_IsZeroFill(byte segType, uint segOffset, uint dataBase[]) {
+  if (zeroStub == NO_STUB) {
+    return 0;
+  }
+  if (segType == SEG_STACK) {
+    return 1;
+  }
+  if (segType == SEG_DATA) {
+    // dataBase less file offset of DATA is this module's data origin.
+    segOffset += dataBase[0] - exeHdrLen - segLengths[SEG_CODE];
+    if (segOffset >= dataInit) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 // A2H LIDATA Logical Iterated Data Record
 // Like the LEDATA record, the LIDATA record contains binary data—executable
 // code or program data. The data in an LIDATA record, however, is specified
@@ -995,7 +1462,7 @@ P4_LEDATA(uint length, uint fd, uint outfd, uint codeBase[], uint dataBase[],
 P4_LIDATA(uint length, uint fd, uint outfd, uint codeBase[], uint dataBase[],
   byte *segType, int *segOffset) {
   uint segBase[2];
-  uint repeat, count;
+  byte *block;
   length -= 4; // length includes segment type, offset, and checksum
   *segType = read_u8(fd);
   *segOffset = read_u16(fd);
@@ -1007,69 +1474,100 @@ P4_LIDATA(uint length, uint fd, uint outfd, uint codeBase[], uint dataBase[],
     fatalf("P4_LIDATA: segType of %u, must be between 1 and 3.", *segType);
   }
   *segType = locSegs[*segType - 1]; // transform to local segment index.
+  if (P4_IsZeroFill(*segType, *segOffset, dataBase)) {
+    forward(fd, length + 1); // skip data and checksum.
+    return;
+  }
   P4_SetBase(*segType, codeBase, dataBase, segBase);
   Add1632(*segOffset, segBase); // segBase[0] += *segOffset;
   bseek(outfd, segBase, 0);
-  while (length > 1) {
-    repeat = read_u16(fd); // number of times the Content field will repeat. 
-    count = read_u16(fd); // determines interpretation of the Content field:
-    length -= 4;
-    // 0  Indicates that the Content field that follows is a 1-byte count value  
-    //    followed by count data bytes. Data bytes will be mapped to memory, 
-    //    repeated as many times as are specified in the Repeat Count field.
-    // !0 Indicates that the Content field that follows is composed of one or
-    //    more Data Block fields. The value in the Block Count field specifies
-    //    the number of Data Block fields (recursive definition).
-    if (fdDebug != 0xffff) {
-      fprintf(fdDebug, "    Repeat=%x Blocks=%x\n", repeat, count);
-    }
-    if (count == 0) {
-      P4_LIINNER(fd, outfd, repeat, &length);
-    }
-    else if (count == 1) {
-      // count is times to repeat inner blocks.
-      // I am just going to fudge this so it can handle asm.lib. It needs a 
-      // rewrite to handle this recursively
-      repeat = read_u16(fd);
-      count = read_u16(fd);
-      length -= 4;
-      if (count == 0x0000) {
-        P4_LIINNER(fd, outfd, repeat, &length);
-      }
-    }
-    else {
-      int i;
-      if (fdDebug != 0xffff) {
-        byte xxx;
-        write_x16(fdDebug, repeat);
-        write_x16(fdDebug, count);
-        for (i = 0; i < length; i++) {
-          xxx = read_u8(fd);
-          write_x8(fdDebug, xxx);
-        }
-      }
-      fatalf("P4_LIDATA: Block Count of %u, must be 0. ", count);
-    }
-  }
+  // The Data Blocks are read in whole, as nested blocks are expanded once per
+  // repeat of the enclosing block.
+  if (length > LIDATA_MAX) {
+    fatalf("P4_LIDATA: Record of %u bytes, must be 1024 or less.", length);
+  }
+  fread(liBuffer, 1, length, fd);
+  liEnd = liBuffer + length;
+  liOutNext = 0;
+  block = liBuffer;
+  while (block < liEnd) {
+    block = P4_LIBLOCK(block, outfd, 1);
+  }
+  P4_LIFLUSH(outfd);
   read_u8(fd); // checksum. assume correct.
 }
 
-P4_LIINNER(uint fd, uint outfd, uint repeat, uint *length) {
-  int i, j;
-  uint count;
-  count = read_u8(fd);
-  *length -= 1 + count;
-  if (count > LINESIZE) {
-    // we COULD handle block size of 256 if necessary...
-    fatalf("P4_LIINNER: Block Size of %u, must be 128 or less. ", count);
+// Expands the Data Block at block into liOut, and returns the address of the
+// byte following it. A Data Block is a Repeat Count, a Block Count, and:
+// 0  Indicates that the Content field that follows is a 1-byte count value  
+//    followed by count data bytes. Data bytes will be mapped to memory, 
+//    repeated as many times as are specified in the Repeat Count field.
+// !0 Indicates that the Content field that follows is composed of one or
+//    more Data Block fields. The value in the Block Count field specifies
+//    the number of Data Block fields (recursive definition).
+// If emit is 0, the block is only walked to find its end.
+P4_LIBLOCK(byte *block, uint outfd, byte emit) {
+  uint repeat, count, size, i, j;
+  byte *next;
+  if (block + 4 >= liEnd) {
+    fatal("P4_LIBLOCK: Data Block runs past end of LIDATA record.");
+  }
+  repeat = block[0] + (block[1] << 8);
+  count = block[2] + (block[3] << 8);
+  block += 4;
+  if (fdDebug != 0xffff) {
+    fprintf(fdDebug, "    Repeat=%x Blocks=%x\n", repeat, count);
   }
-  for (i = 0; i < count; i++) {
-    line[i] = read_u8(fd);
+  if (count == 0) {
+    size = *block++;
+    if (block + size > liEnd) {
+      fatal("P4_LIBLOCK: Content runs past end of LIDATA record.");
+    }
+    if (emit) {
+      for (i = 0; i < repeat; i++) {
+        P4_LIPUT(block, size, outfd);
+      }
+    }
+    return block + size;
+  }
+  if (repeat == 0) {
+    emit = 0;
+    repeat = 1;
   }
   for (i = 0; i < repeat; i++) {
+    next = block;
     for (j = 0; j < count; j++) {
-      write_f8(outfd, line[j]);
+      next = P4_LIBLOCK(next, outfd, emit);
+    }
+  }
+  return next;
+}
+
+// Copies size bytes of content to liOut, writing liOut out whenever it fills.
+P4_LIPUT(byte *content, uint size, uint outfd) {
+  uint n;
+  byte *out;
+  while (size > 0) {
+    n = LIOUT_LEN - liOutNext;
+    if (n > size) {
+      n = size;
     }
+    size -= n;
+    out = liOut + liOutNext;
+    liOutNext += n;
+    while (n-- > 0) {
+      *out++ = *content++;
+    }
+    if (liOutNext == LIOUT_LEN) {
+      P4_LIFLUSH(outfd);
+    }
+  }
+}
+
+P4_LIFLUSH(uint outfd) {
+  if (liOutNext != 0) {
+    fwrite(liOut, 1, liOutNext, outfd);
+    liOutNext = 0;
   }
 }
 
@@ -1094,7 +1592,7 @@ P4_LIINNER(uint fd, uint outfd, uint repeat, uint *length) {
 // subrecords may be smaller than one in which THREAD subrecords are not used.
 P4_FIXUPP(uint length, uint fd, uint outfd, uint codeBase[], uint dataBase[],
   byte segType, int segOffset) {
-  byte lLocat;    // 0x80 set: this is a fixup (unset: a thread, not handled)
+  byte lLocat;    // 0x80 set: this is a fixup (unset: a thread)
                   // 0x40 unset: Self-relative, set: segment-relative
   byte lRefType;  // type of reference
   uint lOffset;   // location offset
@@ -1106,11 +1604,15 @@ P4_FIXUPP(uint length, uint fd, uint outfd, uint codeBase[], uint dataBase[],
     fprintf(fdDebug, "  FIXUPP\n");
   }
   while (length > 1) {
-    length = rd_fix_locat(length, fd, &lOffset, &lLocat, &lRefType);
-    // --- fixupp reference ---------------------------------------------------
+    lLocat = read_u8(fd);
+    length -= 1;
     if ((lLocat & 0x80) == 0) {
-      fatalf("P4_FIXUPP: must be fixup, not thread (locat=%x).", lLocat);
+      // --- thread: sets a frame or target method for later fixups ----------
+      length = rd_fix_thread(length, fd, lLocat);
+      continue;
     }
+    length = rd_fix_locat(length, fd, lLocat, &lOffset, &lRefType);
+    // --- fixupp reference ---------------------------------------------------
     if (fdDebug != 0xffff) {
       if ((lLocat & 0x40) == 0) {
         // fixup is rel to where fixup occurs
@@ -1188,48 +1690,31 @@ P4_FixCheckMatch(byte tFrame, byte tTarget) {
 P4_FixExt(uint outfd, byte lLocat, byte lRefType, uint lOffset, byte fixExt,
   uint fixOffset, uint codeBase[], uint dataBase[], byte segType,
   int segOffset) {
-  int extName, pbdfIndex, modOrigin;
-  byte segOfExt, modOfExt;
+  int extName, pbdfIndex, extBase;
+  uint addrOfExt, written;
+  byte segOfExt;
   if (lRefType != 1) {
     fatalf("P4_FixExt: Unhandled ref type &u.", lRefType);
   }
   if (segType != SEG_CODE) {
     fatal("P4_FixExt: Segment type must be CODE");
   }
-  if (fixExt > extCount) {
+  if (fixExt == 0 || fixExt > extCount) {
     fatalf2("P4_FixExt: Ext index of %u is greater than ext count of %u.", 
       fixExt, extCount);
   }
-  extName = GetName(fixExt - 1, extBuffer, EXTBUF_LEN);
-  if (extName == NOT_DEFINED) {
-    fatalf("P4_FixExt: Could not find ext index %u.", fixExt);
-  }
-  pbdfIndex = FindPubDef(extName, 0);
-  if (pbdfIndex == NOT_DEFINED) {
-    fatalf("P4_FixExt: No pubdef defined matching extdef %s.", extName);
-  }
-  else if (pbdfIndex == NOT_INCLUDED) {
-    // this can probably be removed - would error out in P2.
-    fatalf("P4_FixExt: Unincluded pubdef matches %s.", extName);
-  }
-  pbdfIndex = pbdfIndex * PBDF_PER;
-  segOfExt = pbdfData[pbdfIndex + PBDF_WHERE] & 0x00ff;
-  modOfExt = pbdfData[pbdfIndex + PBDF_WHERE] >> 8;
-  modOrigin = (pbdfData[pbdfIndex + PBDF_WHERE] >> 8) * MDAT_PER;
-  switch (segOfExt) {
-    case SEG_CODE:
-      modOrigin = modData[modOrigin + MDAT_CSO];
-      break;
-    case SEG_DATA:
-      modOrigin = modData[modOrigin + MDAT_DSO];
-      break;
-    default:
-      fatalf("P4_FixExt: Ext is in unhandled seg of index %x", segOfExt);
-      break;
+  extBase = (fixExt - 1) * EXTR_PER;
+  segOfExt = extResolved[extBase + EXTR_SEG];
+  addrOfExt = extResolved[extBase + EXTR_ADDR];
+  pbdfIndex = extResolved[extBase + EXTR_PBDF] * PBDF_PER;
+  extName = pbdfData[pbdfIndex + PBDF_NAME];
+  if ((segOfExt != SEG_CODE) && (segOfExt != SEG_DATA)) {
+    fatalf("P4_FixExt: Ext is in unhandled seg of index %x", segOfExt);
   }
   if (fdDebug != 0xffff) {
     fprintf(fdDebug, "Tgt=Ext%x (%s; Seg=0x%x Mod=%s+0x%x)\n", 
-      fixExt, extName, segOfExt, modData[(modOfExt) * MDAT_PER + MDAT_NAM],
+      fixExt, extName, segOfExt,
+      modData[pbdfData[pbdfIndex + PBDF_MOD] * MDAT_PER + MDAT_NAM],
       pbdfData[pbdfIndex + PBDF_ADDR]);
   }
   if ((lLocat & 0x40) == 0) {
@@ -1239,20 +1724,46 @@ P4_FixExt(uint outfd, byte lLocat, byte lRefType, uint lOffset, byte fixExt,
       fatalf("P4_FixExt: IP-Rel fixupps must resolve to CODE segment (%s)",
         extName);
     }
-    P4_DoFixupp(outfd, modOrigin, pbdfData[pbdfIndex + PBDF_ADDR] + fixOffset, 1, 
+    written = P4_DoFixupp(outfd, addrOfExt, fixOffset, 1, 
       codeBase[0], lOffset + segOffset);
   }
   else {
     // relative to beginning of segment.
-    P4_DoFixupp(outfd, modOrigin, pbdfData[pbdfIndex + PBDF_ADDR] + fixOffset, 0, 
+    if (segOfExt == SEG_CODE) {
+      addrOfExt += codeOrigin;
+    }
+    else {
+      addrOfExt += dataOrigin;
+    }
+    written = P4_DoFixupp(outfd, addrOfExt, fixOffset, 0, 
       codeBase[0], lOffset + segOffset);
   }
+  if (pathInc != 0) {
+    P4_AddSite(codeBase[0] + lOffset + segOffset,
+      extResolved[extBase + EXTR_PBDF],
+      written - extResolved[extBase + EXTR_ADDR]);
+  }
+}
+
+// Note where an extdef fixupp was written, so that an incremental link can
+// repatch it if the pubdef it refers to moves.
+P4_AddSite(uint pos, int pbdfIndex, uint addend) {
+  int siteBase;
+  if (siteCount == siteMax) {
+    siteData = GrowMem(siteData, &siteMax, SITE_PER * 2);
+  }
+  siteBase = siteCount * SITE_PER;
+  siteData[siteBase + SITE_MOD] = modLinking;
+  siteData[siteBase + SITE_POS] = pos;
+  siteData[siteBase + SITE_PBDF] = pbdfIndex;
+  siteData[siteBase + SITE_ADD] = addend;
+  siteCount += 1;
 }
 
 P4_FixSeg(uint outfd, byte lLocat, byte lRefType, uint lOffset, byte fixSeg,
   uint fixOffset, uint codeBase[], uint dataBase[], byte segType,
   int segOffset) {
-  uint segBase[2];
+  uint segBase[2], i;
   if (fdDebug != 0xffff) {
     fprintf(fdDebug, "Tgt=Seg%u+0x%x\n", fixSeg, fixOffset);
   }
@@ -1283,10 +1794,11 @@ P4_FixSeg(uint outfd, byte lLocat, byte lRefType, uint lOffset, byte fixSeg,
       uint whereBase;
       switch (locSegs[fixSeg]) {
         case SEG_CODE:
-          whereBase = codeBase[0] - EXE_HDR_LEN;
+          whereBase = codeBase[0] - exeHdrLen + codeOrigin;
           break;
         case SEG_DATA:
-          whereBase = dataBase[0] - EXE_HDR_LEN - segLengths[SEG_CODE];
+          whereBase = dataBase[0] - exeHdrLen - segLengths[SEG_CODE];
+          whereBase += dataOrigin;
           break;
         default:
           fatalf("P4_FixSeg: Unhandled relative seg base index %u.", fixSeg);
@@ -1297,6 +1809,12 @@ P4_FixSeg(uint outfd, byte lLocat, byte lRefType, uint lOffset, byte fixSeg,
     else if (lRefType == 2) {
       // 16-bit logical segment base
       uint logBase;
+      if (outCom) {
+        printf("%s refers to a segment base at CODE:0x%x.\n",
+          modData[modLinking * MDAT_PER + MDAT_NAM],
+          codeBase[0] + lOffset + segOffset - exeHdrLen);
+        fatal("A com file cannot hold segment relocations; link as an exe.");
+      }
       switch (locSegs[fixSeg]) {
         case SEG_CODE:
           logBase = 0;
@@ -1312,7 +1830,13 @@ P4_FixSeg(uint outfd, byte lLocat, byte lRefType, uint lOffset, byte fixSeg,
             fixSeg, locSegs[fixSeg]);
       }
       P4_DoFixupp(outfd, logBase, 0, 0, codeBase[0], lOffset + segOffset);
-      relocData[relocCount++] = codeBase[0] + lOffset + segOffset - EXE_HDR_LEN;
+      if (relocCount == relocMax) {
+        relocData = GrowMem(relocData, &relocMax, RELOC_PER * 2);
+      }
+      i = relocCount * RELOC_PER;
+      relocData[i + RELOC_POS] = codeBase[0] + lOffset + segOffset - exeHdrLen;
+      relocData[i + RELOC_MOD] = modLinking;
+      relocCount += 1;
     }
   }
 }
@@ -1331,7 +1855,7 @@ P4_DoFixupp(uint fd, uint what, uint whatOff, uint whatRelative,
   uint nowAddr[2];
   uint offset;
   if (whatRelative == 1) {
-    offset = where + whereOff + 2 - EXE_HDR_LEN;
+    offset = where + whereOff + 2 - exeHdrLen;
   }
   else {
     offset = 0;
@@ -1350,6 +1874,7 @@ P4_DoFixupp(uint fd, uint what, uint whatOff, uint whatRelative,
   if (what + whatOff - offset == 0xa84) {
     // abort(1);
   }
+  return what + whatOff - offset;
 }
 
 P4_SetBase(byte segType, uint codeBase[], uint dataBase[], uint segBase[]) {
@@ -1363,7 +1888,7 @@ P4_SetBase(byte segType, uint codeBase[], uint dataBase[], uint segBase[]) {
   }
   else if (segType == SEG_STACK) {
     // this is why we can only have one stack segment.
-    segBase[0] = EXE_HDR_LEN + segLengths[SEG_CODE];
+    segBase[0] = exeHdrLen + segLengths[SEG_CODE];
     segBase[1] = 0;
     Add1632(segLengths[SEG_DATA], segBase);
   }
@@ -1390,6 +1915,546 @@ Add1632(uint a, uint b[]) {
   b[0] += a;
 }
 
+// ============================================================================
+// === Incremental Link =======================================================
+// ============================================================================
+// With -i, each module's code and data get slots with room to grow, and the
+// layout, the pubdefs, the relocations, and every extdef fixupp site are saved
+// to a state file after linking. On the next link, input files whose size or
+// time stamp changed are found. Each changed object module is reread; if it
+// still fits its slots, defines the same pubdefs, and needs no module that is
+// not already linked, it is linked in place in the existing output file and
+// the fixupps that refer to its pubdefs are repatched. Otherwise all passes
+// are run again.
+
+// Returns 1 if the output file was brought up to date, 0 if a full link is
+// needed.
+IncLink() {
+  uint i, j, m, fd, checksum, changed;
+  uint info[4];
+  if (IncLoad() == 0) {
+    return IncFail("no matching state file");
+  }
+  if ((fd = fopen(pathOutput, "r")) == 0) {
+    return IncFail("no output file");
+  }
+  fclose(fd);
+  changed = 0;
+  for (i = 0; i < fileCount; i++) {
+    FileInfo(filePaths[i], info);
+    for (j = 0; j < 4; j++) {
+      if (info[j] != incFiles[i * 4 + j]) {
+        break;
+      }
+    }
+    if (j == 4) {
+      continue;
+    }
+    if ((m = IncModOf(i)) == NOT_DEFINED) {
+      return IncFail("a library or an unused file changed");
+    }
+    if (fdDebug != 0xffff) {
+      fprintf(fdDebug, "Relinking %s (%s)\n", modData[m * MDAT_PER + MDAT_NAM],
+        filePaths[i]);
+    }
+    if (IncPatch(m) == 0) {
+      return 0;
+    }
+    changed += 1;
+  }
+  if ((outCom == 0) && (ExeHdrLen(relocCount) > exeHdrLen)) {
+    return IncFail("the relocations outgrew the exe header");
+  }
+  printf("  Incremental: %u file(s) relinked.\n", changed);
+  if (changed != 0) {
+    if (outCom) {
+      WriteComJump();
+    }
+    else {
+      WriteExeHeader(0);
+      checksum = CalcChecksum();
+      WriteExeHeader(checksum);
+    }
+  }
+  return 1;
+}
+
+IncFail(char *reason) {
+  int i;
+  printf("  Incremental link not possible: %s.\n", reason);
+  // discard the loaded state, as Pass1-Pass3 rebuild it from scratch.
+  for (i = 0; i < SEGS_CNT; i++) {
+    segLengths[i] = 0;
+  }
+  exeStartAddress = 0xffff;
+  libInLib = 0;
+  return 0;
+}
+
+// Returns the index of the one module in input file fileIndex, if it is an
+// included object module, or NOT_DEFINED.
+IncModOf(int fileIndex) {
+  int i, found;
+  found = NOT_DEFINED;
+  for (i = 0; i < modCount; i++) {
+    if (modData[i * MDAT_PER + MDAT_FIL] == fileIndex) {
+      if (found != NOT_DEFINED) {
+        return NOT_DEFINED;
+      }
+      found = i;
+    }
+  }
+  if (found != NOT_DEFINED) {
+    i = modData[found * MDAT_PER + MDAT_FLG];
+    if (((i & FlgInclude) == 0) || ((i & FlgInLib) != 0)) {
+      return NOT_DEFINED;
+    }
+  }
+  return found;
+}
+
+// Rereads changed module m, and links it in place if it still fits. Returns
+// 0 (after IncFail) if a full link is needed.
+IncPatch(int m) {
+  uint fd, outfd, i, j, k, mBase, nBase, oldStart, newStart;
+  uint modOffset[2], codeBase[2], dataBase[2];
+  int n, oldCount, *oldNames;
+  mBase = m * MDAT_PER;
+  if (modData[mBase + MDAT_FLG] & FlgStack) {
+    return IncFail("the module defining the stack changed");
+  }
+  // Hide m's pubdefs, so that rereading m with Pass1 does not find them as
+  // duplicates. m is reread as a new module n, with new pubdefs after
+  // oldCount.
+  oldCount = pbdfCount;
+  oldNames = AllocMem(oldCount + 1, 2);
+  for (i = 0; i < oldCount; i++) {
+    if (pbdfData[i * PBDF_PER + PBDF_MOD] == m) {
+      oldNames[i] = pbdfData[i * PBDF_PER + PBDF_NAME];
+      pbdfData[i * PBDF_PER + PBDF_NAME] = "";
+    }
+  }
+  oldStart = exeStartAddress;
+  n = modCount;
+  fd = safefopen(filePaths[modData[mBase + MDAT_FIL]], "r");
+  P1_RdFile(modData[mBase + MDAT_FIL], fd);
+  safefclose(fd);
+  newStart = exeStartAddress; // P1_MODEND: offset in m's code.
+  exeStartAddress = oldStart;
+  for (i = 0; i < oldCount; i++) {
+    if (pbdfData[i * PBDF_PER + PBDF_MOD] == m) {
+      pbdfData[i * PBDF_PER + PBDF_NAME] = oldNames[i];
+    }
+  }
+  if (modCount != n + 1) {
+    return IncFail("the module could not be reread");
+  }
+  modCount = n;
+  nBase = n * MDAT_PER;
+  if ((modData[nBase + MDAT_CSO] > modData[mBase + MDAT_CSL]) ||
+    (modData[nBase + MDAT_DSO] > modData[mBase + MDAT_DSL])) {
+    return IncFail("the module no longer fits its slots");
+  }
+  if ((modData[nBase + MDAT_FLG] ^ modData[mBase + MDAT_FLG]) &
+    (FlgStart | FlgStack)) {
+    return IncFail("the module changed its start or stack");
+  }
+  // match the new pubdefs to the old: the old take the new addresses, and
+  // pubdefs that are new to m are kept as m's.
+  k = oldCount;
+  for (j = oldCount; j < pbdfCount; j++) {
+    for (i = 0; i < oldCount; i++) {
+      if ((pbdfData[i * PBDF_PER + PBDF_MOD] == m) &&
+        (SameName(pbdfData[i * PBDF_PER + PBDF_NAME],
+        pbdfData[j * PBDF_PER + PBDF_NAME]))) {
+        break;
+      }
+    }
+    if (i < oldCount) {
+      if (pbdfData[i * PBDF_PER + PBDF_SEG] !=
+        pbdfData[j * PBDF_PER + PBDF_SEG]) {
+        return IncFail("a public moved to another segment");
+      }
+      pbdfData[i * PBDF_PER + PBDF_ADDR] = pbdfData[j * PBDF_PER + PBDF_ADDR];
+      oldNames[i] = 0; // matched
+    }
+    else {
+      pbdfData[k * PBDF_PER + PBDF_NAME] = pbdfData[j * PBDF_PER + PBDF_NAME];
+      pbdfData[k * PBDF_PER + PBDF_SEG] = pbdfData[j * PBDF_PER + PBDF_SEG];
+      pbdfData[k * PBDF_PER + PBDF_ADDR] = pbdfData[j * PBDF_PER + PBDF_ADDR];
+      pbdfData[k * PBDF_PER + PBDF_MOD] = m;
+      k++;
+    }
+  }
+  pbdfCount = k;
+  for (i = 0; i < oldCount; i++) {
+    if ((pbdfData[i * PBDF_PER + PBDF_MOD] == m) && (oldNames[i] != 0)) {
+      return IncFail("a public was removed");
+    }
+  }
+  modData[mBase + MDAT_CLN] = modData[nBase + MDAT_CSO];
+  modData[mBase + MDAT_DLN] = modData[nBase + MDAT_DSO];
+  modData[mBase + MDAT_THD] = modData[nBase + MDAT_THD];
+  modData[mBase + MDAT_RLC] = modData[nBase + MDAT_RLC];
+  if (modData[mBase + MDAT_FLG] & FlgStart) {
+    exeStartAddress = modData[mBase + MDAT_CSO] + newStart;
+    if (outCom && ((exeStartAddress == 0) != (exeHdrLen == 0))) {
+      return IncFail("the com start address moved");
+    }
+  }
+  // every extdef of m must match a pubdef that is already linked.
+  fd = safefopen(filePaths[modData[mBase + MDAT_FIL]], "r");
+  modOffset[0] = modData[mBase + MDAT_THD];
+  modOffset[1] = 0;
+  bseek(fd, modOffset, 0);
+  extNext = 0;
+  extCount = 0;
+  extMod = m;
+  P2_DoMod(fd);
+  if (extCount != 0) {
+    safefclose(fd);
+    return IncFail("the module needs a library module not yet linked");
+  }
+  // forget m's old fixupp sites and relocations, then link m into its slots.
+  IncDrop(siteData, &siteCount, SITE_PER, SITE_MOD, m);
+  IncDrop(relocData, &relocCount, RELOC_PER, RELOC_MOD, m);
+  outfd = safefopen(pathOutput, "r+");
+  codeBase[0] = exeHdrLen + modData[mBase + MDAT_CSO];
+  codeBase[1] = 0;
+  dataBase[0] = exeHdrLen + segLengths[SEG_CODE];
+  dataBase[1] = 0;
+  Add1632(modData[mBase + MDAT_DSO], dataBase);
+  IncClear(outfd, codeBase, modData[mBase + MDAT_CSL]);
+  IncClear(outfd, dataBase, modData[mBase + MDAT_DSL]);
+  bseek(fd, modOffset, 0);
+  extCount = 0;
+  modLinking = m;
+  P4_DoMod(fd, outfd, codeBase, dataBase);
+  safefclose(fd);
+  // repatch the fixupps in other modules that refer to m's pubdefs.
+  for (i = 0; i < siteCount; i++) {
+    j = siteData[i * SITE_PER + SITE_PBDF];
+    if ((pbdfData[j * PBDF_PER + PBDF_MOD] == m) &&
+      (siteData[i * SITE_PER + SITE_MOD] != m)) {
+      P4_DoFixupp(outfd, IncAddress(j), siteData[i * SITE_PER + SITE_ADD], 0,
+        siteData[i * SITE_PER + SITE_POS], 0);
+    }
+  }
+  safefclose(outfd);
+  return 1;
+}
+
+// Returns the final address of a pubdef in its segment, not counting
+// codeOrigin or dataOrigin (as in extResolved).
+IncAddress(int pbdfIdx) {
+  int pbdfBase, mdatBase;
+  pbdfBase = pbdfIdx * PBDF_PER;
+  mdatBase = pbdfData[pbdfBase + PBDF_MOD] * MDAT_PER;
+  if (pbdfData[pbdfBase + PBDF_SEG] == SEG_CODE) {
+    return modData[mdatBase + MDAT_CSO] + pbdfData[pbdfBase + PBDF_ADDR];
+  }
+  return modData[mdatBase + MDAT_DSO] + pbdfData[pbdfBase + PBDF_ADDR];
+}
+
+// Removes the entries of module m from a table of *count entries of per
+// words, where word modField of each entry is a module index.
+IncDrop(int *table, int *count, int per, int modField, int m) {
+  int i, j, k;
+  k = 0;
+  for (i = 0; i < *count; i++) {
+    if (table[i * per + modField] != m) {
+      for (j = 0; j < per; j++) {
+        table[k * per + j] = table[i * per + j];
+      }
+      k++;
+    }
+  }
+  *count = k;
+}
+
+// Zeroes length bytes of the output file at base.
+IncClear(uint outfd, uint base[], uint length) {
+  bseek(outfd, base, 0);
+  while (length-- > 0) {
+    write_f8(outfd, 0);
+  }
+}
+
+// Saves the link state: arguments, input files, layout, modules, pubdefs,
+// relocations, and fixupp sites.
+IncSave() {
+  uint fd, i, j;
+  uint info[4];
+  unlink(pathInc);
+  fd = safefopen(pathInc, "w");
+  write_f16(fd, INC_MAGIC);
+  write_f16(fd, INC_VERSION);
+  IncPutStr(fd, pathOutput);
+  write_f16(fd, outCom);
+  write_f16(fd, fileCount);
+  for (i = 0; i < fileCount; i++) {
+    IncPutStr(fd, filePaths[i]);
+    FileInfo(filePaths[i], info);
+    for (j = 0; j < 4; j++) {
+      write_f16(fd, info[j]);
+    }
+  }
+  for (i = 0; i < SEGS_CNT; i++) {
+    write_f16(fd, segLengths[i]);
+  }
+  write_f16(fd, exeStartAddress);
+  write_f16(fd, exeHdrLen);
+  write_f16(fd, codeOrigin);
+  write_f16(fd, dataOrigin);
+  write_f16(fd, modCount);
+  for (i = 0; i < modCount; i++) {
+    IncPutStr(fd, modData[i * MDAT_PER + MDAT_NAM]);
+    for (j = MDAT_NAM + 1; j < MDAT_PER; j++) {
+      write_f16(fd, modData[i * MDAT_PER + j]);
+    }
+  }
+  write_f16(fd, pbdfCount);
+  for (i = 0; i < pbdfCount; i++) {
+    IncPutStr(fd, pbdfData[i * PBDF_PER + PBDF_NAME]);
+    for (j = PBDF_NAME + 1; j < PBDF_PER; j++) {
+      write_f16(fd, pbdfData[i * PBDF_PER + j]);
+    }
+  }
+  write_f16(fd, relocCount);
+  for (i = 0; i < relocCount * RELOC_PER; i++) {
+    write_f16(fd, relocData[i]);
+  }
+  write_f16(fd, siteCount);
+  for (i = 0; i < siteCount * SITE_PER; i++) {
+    write_f16(fd, siteData[i]);
+  }
+  safefclose(fd);
+}
+
+// Loads the state saved by IncSave. Returns 1 if it was saved by a link with
+// the same output and input files.
+IncLoad() {
+  uint fd, i, j, length;
+  if ((fd = fopen(pathInc, "r")) == 0) {
+    return 0;
+  }
+  if ((read_u16(fd) != INC_MAGIC) || (read_u16(fd) != INC_VERSION)) {
+    return IncNoLoad(fd);
+  }
+  readstrpre(line, fd);
+  if (strcmp(line, pathOutput) != 0) {
+    return IncNoLoad(fd);
+  }
+  if ((read_u16(fd) != outCom) || (read_u16(fd) != fileCount)) {
+    return IncNoLoad(fd);
+  }
+  incFiles = AllocMem(fileCount * 4, 2);
+  for (i = 0; i < fileCount; i++) {
+    readstrpre(line, fd);
+    if (strcmp(line, filePaths[i]) != 0) {
+      return IncNoLoad(fd);
+    }
+    for (j = 0; j < 4; j++) {
+      incFiles[i * 4 + j] = read_u16(fd);
+    }
+  }
+  for (i = 0; i < SEGS_CNT; i++) {
+    segLengths[i] = read_u16(fd);
+  }
+  exeStartAddress = read_u16(fd);
+  exeHdrLen = read_u16(fd);
+  codeOrigin = read_u16(fd);
+  dataOrigin = read_u16(fd);
+  dataInit = segLengths[SEG_DATA];
+  zeroStub = NO_STUB;
+  modCount = read_u16(fd);
+  while (modCount >= modMax) {
+    modData = GrowMem(modData, &modMax, MDAT_PER * 2);
+  }
+  for (i = 0; i < modCount; i++) {
+    length = readstrpre(line, fd);
+    modData[i * MDAT_PER + MDAT_NAM] = AllocMem(length, 1);
+    strcpy(modData[i * MDAT_PER + MDAT_NAM], line);
+    for (j = MDAT_NAM + 1; j < MDAT_PER; j++) {
+      modData[i * MDAT_PER + j] = read_u16(fd);
+    }
+  }
+  pbdfCount = read_u16(fd);
+  while (pbdfCount >= pbdfMax) {
+    pbdfData = GrowMem(pbdfData, &pbdfMax, PBDF_PER * 2);
+  }
+  for (i = 0; i < pbdfCount; i++) {
+    length = readstrpre(line, fd);
+    pbdfData[i * PBDF_PER + PBDF_NAME] = AllocMem(length, 1);
+    strcpy(pbdfData[i * PBDF_PER + PBDF_NAME], line);
+    for (j = PBDF_NAME + 1; j < PBDF_PER; j++) {
+      pbdfData[i * PBDF_PER + j] = read_u16(fd);
+    }
+  }
+  relocCount = read_u16(fd);
+  while (relocCount > relocMax) {
+    relocData = GrowMem(relocData, &relocMax, RELOC_PER * 2);
+  }
+  for (i = 0; i < relocCount * RELOC_PER; i++) {
+    relocData[i] = read_u16(fd);
+  }
+  siteCount = read_u16(fd);
+  while (siteCount > siteMax) {
+    siteData = GrowMem(siteData, &siteMax, SITE_PER * 2);
+  }
+  for (i = 0; i < siteCount * SITE_PER; i++) {
+    siteData[i] = read_u16(fd);
+  }
+  if (feof(fd) || ferror(fd)) {
+    return IncNoLoad(fd);
+  }
+  safefclose(fd);
+  return 1;
+}
+
+IncNoLoad(uint fd) {
+  safefclose(fd);
+  return 0;
+}
+
+IncPutStr(uint fd, char *str) {
+  write_f8(fd, strlen(str));
+  while (*str != 0) {
+    write_f8(fd, *str++);
+  }
+}
+
+// ============================================================================
+// === Map File ===============================================================
+// ============================================================================
+// The map file lists the segments; each included module with the origin and
+// length of its code and data, and the extdef that pulled it in from a
+// library; and each public with its final address, in address order.
+WriteMap() {
+  uint fd;
+  unlink(pathMap);
+  fd = safefopen(pathMap, "w");
+  fprintf(fd, "%s\n\nMap of %s\n\n", VERSION, pathOutput);
+  Map_Segments(fd);
+  Map_Modules(fd);
+  Map_Publics(fd);
+  safefclose(fd);
+}
+
+Map_Segments(uint fd) {
+  fprintf(fd, "Segment  Start  Length\n");
+  fprintf(fd, "CODE     %04x   %04x\n", codeOrigin, segLengths[SEG_CODE]);
+  fprintf(fd, "DATA     %04x   %04x\n", dataOrigin, segLengths[SEG_DATA]);
+  fprintf(fd, "STACK    0000   %04x\n", segLengths[SEG_STACK]);
+  if (outCom && (exeHdrLen != 0)) {
+    fprintf(fd, "Jump to start at %04x\n", COM_ORIGIN);
+  }
+  if (zeroStub != NO_STUB) {
+    fprintf(fd, "Zero fill stub at CODE:%04x clears DATA:%04x-%04x\n",
+      codeOrigin + zeroStub, dataOrigin + dataInit,
+      dataOrigin + segLengths[SEG_DATA] - 1);
+  }
+  fprintf(fd, "\n");
+}
+
+Map_Modules(uint fd) {
+  int i, mdatBase, pbdfIdx;
+  fprintf(fd, "Module               CODE       DATA       Included\n");
+  for (i = 0; i < modCount; i++) {
+    mdatBase = i * MDAT_PER;
+    if ((modData[mdatBase + MDAT_FLG] & FlgInclude) == FlgInclude) {
+      fprintf(fd, "%-20s %04x+%04x  %04x+%04x  ",
+        modData[mdatBase + MDAT_NAM],
+        codeOrigin + modData[mdatBase + MDAT_CSO],
+        modData[mdatBase + MDAT_CLN],
+        dataOrigin + modData[mdatBase + MDAT_DSO],
+        modData[mdatBase + MDAT_DLN]);
+      pbdfIdx = modData[mdatBase + MDAT_WHY];
+      if (pbdfIdx == NOT_DEFINED) {
+        fprintf(fd, "from %s\n", filePaths[modData[mdatBase + MDAT_FIL]]);
+      }
+      else {
+        fprintf(fd, "from %s for %s in %s\n",
+          filePaths[modData[mdatBase + MDAT_FIL]],
+          pbdfData[pbdfIdx * PBDF_PER + PBDF_NAME],
+          modData[modData[mdatBase + MDAT_BY] * MDAT_PER + MDAT_NAM]);
+      }
+    }
+  }
+  fprintf(fd, "\n");
+}
+
+Map_Publics(uint fd) {
+  int *order, count, i, j, pbdfIdx, modIndex;
+  // insertion sort the included pubdefs by address. Pubdefs are mostly in
+  // address order already, so this is nearly linear.
+  order = AllocMem(pbdfCount + 1, 2);
+  count = 0;
+  for (i = 0; i < pbdfCount; i++) {
+    modIndex = pbdfData[i * PBDF_PER + PBDF_MOD];
+    if ((modData[modIndex * MDAT_PER + MDAT_FLG] & FlgInclude) == 0) {
+      continue;
+    }
+    j = count++;
+    while ((j > 0) && (Map_Compare(order[j - 1], i) > 0)) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+  fprintf(fd, "Address     Public               Module\n");
+  for (i = 0; i < count; i++) {
+    pbdfIdx = order[i] * PBDF_PER;
+    switch (pbdfData[pbdfIdx + PBDF_SEG]) {
+      case SEG_CODE:
+        fprintf(fd, "CODE:");
+        break;
+      case SEG_DATA:
+        fprintf(fd, "DATA:");
+        break;
+      default:
+        fprintf(fd, "STCK:");
+        break;
+    }
+    fprintf(fd, "%04x   %-20s %s\n", Map_Address(order[i]),
+      pbdfData[pbdfIdx + PBDF_NAME],
+      modData[pbdfData[pbdfIdx + PBDF_MOD] * MDAT_PER + MDAT_NAM]);
+  }
+  free(order);
+}
+
+// Returns >0 if pubdef a sorts after pubdef b: by segment, then by address.
+Map_Compare(int a, int b) {
+  uint segA, segB;
+  segA = pbdfData[a * PBDF_PER + PBDF_SEG];
+  segB = pbdfData[b * PBDF_PER + PBDF_SEG];
+  if (segA != segB) {
+    return segA - segB;
+  }
+  if (Map_Address(a) > Map_Address(b)) {
+    return 1;
+  }
+  return 0;
+}
+
+// Returns the final address of a pubdef in its segment.
+Map_Address(int pbdfIdx) {
+  int pbdfBase, mdatBase;
+  uint addr;
+  pbdfBase = pbdfIdx * PBDF_PER;
+  mdatBase = pbdfData[pbdfBase + PBDF_MOD] * MDAT_PER;
+  addr = pbdfData[pbdfBase + PBDF_ADDR];
+  switch (pbdfData[pbdfBase + PBDF_SEG]) {
+    case SEG_CODE:
+      addr += codeOrigin + modData[mdatBase + MDAT_CSO];
+      break;
+    case SEG_DATA:
+      addr += dataOrigin + modData[mdatBase + MDAT_DSO];
+      break;
+  }
+  return addr;
+}
+
 // ============================================================================
 // === Pass2 (Library files) ==================================================
 // ============================================================================
@@ -1407,7 +2472,7 @@ Pass2Lib() {
     int mdatBase, mdatFile;
     mdatBase = i * MDAT_PER;
     if ((modData[mdatBase + MDAT_FLG] & FlgInclude) == FlgInclude) {
-      mdatFile = modData[mdatBase + MDAT_FLG] & 0x00ff;
+      mdatFile = modData[mdatBase + MDAT_FIL];
       if (fdDebug != 0xffff) {
         fprintf(fdDebug, "Adding %s (%s) to library... \n", 
           modData[mdatBase + MDAT_NAM], filePaths[mdatFile]);
@@ -1495,7 +2560,7 @@ FindPubDef(char* name, int retAllDefined) {
     matching = pbdfData[i * PBDF_PER + PBDF_NAME];
     for (j = 0; j <= length; j++) {
       if (name[j] == 0 && matching[j] == 0) {
-        modIndex = pbdfData[i * PBDF_PER + PBDF_WHERE] / 256;
+        modIndex = pbdfData[i * PBDF_PER + PBDF_MOD];
         if ((modData[modIndex * MDAT_PER + MDAT_FLG] & FlgInclude) == 0) {
           if (retAllDefined) {
             return i;
@@ -1524,31 +2589,32 @@ rd_fix_target(uint length, uint fd, uint *offset, byte *frmType, byte *tgtType,
   //  In the first three cases  FRAME  INDEX  is  present  in  the
   //  record  and  contains an index of the specified type. In the
   //  last two cases there is no FRAME INDEX field.
-  byte methods;
-  methods = read_u8(fd); // Format is fffftttt
-  *frmType = methods >> 4;
-  *tgtType = methods & 0x0f;
+  //  If the F bit (0x80) is set, the frame is given by the frame thread
+  //  named in the frame bits, and there is no FRAME INDEX field.
+  byte methods, thread;
+  methods = read_u8(fd); // Format is Ffff Tptt
   length -= 1;
-  // I have omitted frame/target methods that SmallC22/SmallA do not emit.
-  switch (*frmType) {
-    case 0x00:     // frame given by a segment index
-    case 0x02:     // frame given by an external index
-      *frame = read_u8(fd);
-      length -= 1;
-      if (*frame >= 0x80) {
-        if (*frame == 0x80) {
-          *frame = read_u8(fd);
-          length -= 1;
-        }
-        else {
-          fatalf("rd_fix_target: unhandled extended frame of 0x%x.", *frame);
-        }
-      }
-      break;
-    default:
-      fatalf2("rd_fix_target: unhandled frame method 0x%x (0x%x)", 
-      *frmType, methods);
-      break;
+  if (methods & 0x80) {
+    thread = THRD_FRM + ((methods >> 4) & 0x03) * 2;
+    if (fixThreads[thread] == THRD_UNDEF) {
+      fatalf("rd_fix_target: frame thread %u is not defined.", thread / 2);
+    }
+    *frmType = fixThreads[thread];
+    *frame = fixThreads[thread + 1];
+  }
+  else {
+    *frmType = (methods >> 4) & 0x07;
+    // I have omitted frame/target methods that SmallC22/SmallA do not emit.
+    switch (*frmType) {
+      case 0x00:     // frame given by a segment index
+      case 0x02:     // frame given by an external index
+        *frame = rd_index(fd, &length);
+        break;
+      default:
+        fatalf2("rd_fix_target: unhandled frame method 0x%x (0x%x)", 
+        *frmType, methods);
+        break;
+    }
   }
   // -----------------------------------------------------------------
   //  The TARGET bits tell LINK to determine the target of  the
@@ -1558,16 +2624,21 @@ rd_fix_target(uint length, uint fd, uint *offset, byte *frmType, byte *tgtType,
   //  specifies the offset from the location of the segment, group, 
   //  or external address to the target. In the last three cases there
   //  is no TARGET OFFSET because an offset of zero is assumed.
-  *target = read_u8(fd);
-  length -= 1;
-  if (*target >= 0x80) {
-    if (*target == 0x80) {
-      *target = read_u8(fd);
-      length -= 1;
-    }
-    else {
-      fatalf("rd_fix_target: unhandled extended target of 0x%x.", *frame);
-    }
+  //  If the T bit (0x08) is set, the target method and index are given by
+  //  the target thread named in the low two bits, and the P bit (0x04) still
+  //  says whether there is a TARGET OFFSET.
+  if (methods & 0x08) {
+    thread = THRD_TGT + (methods & 0x03) * 2;
+    if (fixThreads[thread] == THRD_UNDEF) {
+      fatalf("rd_fix_target: target thread %u is not defined.",
+        (thread - THRD_TGT) / 2);
+    }
+    *tgtType = fixThreads[thread] | (methods & 0x04);
+    *target = fixThreads[thread + 1];
+  }
+  else {
+    *tgtType = methods & 0x07;
+    *target = rd_index(fd, &length);
   }
   // As with frame methods, I have omitted targets SmallC22/SmallA do not emit.
   switch (*tgtType) {
@@ -1587,9 +2658,58 @@ rd_fix_target(uint length, uint fd, uint *offset, byte *frmType, byte *tgtType,
   return length;
 }
 
-// rd_fix_locat: reads the place where the fixupp will be written.
+// rd_fix_thread: reads a THREAD subrecord, whose first byte is trddat, into
+//    the frame or target thread that it names.
 //    Returns the count of bytes remaining in the record.
-rd_fix_locat(uint length, uint fd, uint *offset, byte *locat, byte *lRefType) {
+rd_fix_thread(uint length, uint fd, byte trddat) {
+  // -----------------------------------------------------------------
+  //  TRD DAT is 0Dzmmmtt: D (0x40) set for a frame thread, unset for a
+  //  target thread; mmm is the method; tt is the thread number. An INDEX
+  //  follows for frame methods 0-2 and for all target methods. Target
+  //  threads keep only the low two bits of the method; each FIXUP that uses
+  //  the thread supplies the P bit.
+  byte method, thread;
+  method = (trddat >> 2) & 0x07;
+  if (trddat & 0x40) {
+    thread = THRD_FRM + (trddat & 0x03) * 2;
+    fixThreads[thread + 1] = 0;
+    if (method < 3) {
+      fixThreads[thread + 1] = rd_index(fd, &length);
+    }
+  }
+  else {
+    thread = THRD_TGT + (trddat & 0x03) * 2;
+    method &= 0x03;
+    fixThreads[thread + 1] = rd_index(fd, &length);
+  }
+  fixThreads[thread] = method;
+  if (fdDebug != 0xffff) {
+    fprintf(fdDebug, "    Thread %x: Method=%x Index=%x\n",
+      thread / 2, method, fixThreads[thread + 1]);
+  }
+  return length;
+}
+
+// rd_index: reads a one or two byte index, and subtracts its size from
+//    *length. Indexes are kept in bytes, so must be less than 256.
+rd_index(uint fd, uint *length) {
+  uint index;
+  index = read_u8(fd);
+  *length -= 1;
+  if (index >= 0x80) {
+    index = ((index & 0x7f) << 8) + read_u8(fd);
+    *length -= 1;
+    if (index > 0xff) {
+      fatalf("rd_index: unhandled index of 0x%x.", index);
+    }
+  }
+  return index;
+}
+
+// rd_fix_locat: reads the place where the fixupp will be written. The first
+//    byte, locat, has already been read.
+//    Returns the count of bytes remaining in the record.
+rd_fix_locat(uint length, uint fd, byte locat, uint *offset, byte *lRefType) {
   // -----------------------------------------------------------------
   // The first bit (in the low byte) is always  one  to  indicate
   // that this block defines a "fixup" as opposed to a "thread."
@@ -1603,18 +2723,59 @@ rd_fix_locat(uint length, uint fd, uint *offset, byte *locat, byte *lRefType) {
   //  * Segment-relative references locate a target address in any segment 
   //    relative to the beginning of the segment. This is just the
   //    "displacement" field that occurs in so many instructions.
-  *locat = read_u8(fd);
   // -----------------------------------------------------------------
   // The TYPE REFERENCE bits (called the LOC  bits  in  Microsoft
   // documentation) encode the type of reference.
-  *lRefType = (*locat & 0x3c) >> 2; // 4 bit field.
+  *lRefType = (locat & 0x3c) >> 2; // 4 bit field.
   // -----------------------------------------------------------------
   //  The DATA RECORD OFFSET subfield specifies the offset, within
   //  the preceding data record, to the reference. Since a  record
   //  can  have at most 1024 data bytes, 10 bits are sufficient to
   //  locate any reference.
-  *offset = read_u8(fd) + ((*locat & 0x03) << 8);
+  *offset = read_u8(fd) + ((locat & 0x03) << 8);
+  length -= 1;
+  return length;
+}
+
+// skip_fix: skips the rest of a FIXUP subrecord whose first byte has been
+//    read, without checking its methods.
+//    Returns the count of bytes remaining in the record.
+skip_fix(uint length, uint fd) {
+  byte fixdat;
+  read_u8(fd);                    // low byte of locat
+  fixdat = read_u8(fd);
   length -= 2;
+  if ((fixdat & 0x80) == 0) {
+    switch ((fixdat >> 4) & 0x07) {
+      case 0x00:                  // segment, group or external index
+      case 0x01:
+      case 0x02:
+        length = skip_index(length, fd);
+        break;
+      case 0x03:                  // frame number
+        read_u16(fd);
+        length -= 2;
+        break;
+    }
+  }
+  if ((fixdat & 0x08) == 0) {
+    length = skip_index(length, fd);
+  }
+  if ((fixdat & 0x04) == 0) {     // target displacement
+    read_u16(fd);
+    length -= 2;
+  }
+  return length;
+}
+
+// skip_index: skips a one or two byte index of any size.
+//    Returns the count of bytes remaining in the record.
+skip_index(uint length, uint fd) {
+  length -= 1;
+  if (read_u8(fd) >= 0x80) {
+    read_u8(fd);
+    length -= 1;
+  }
   return length;
 }
 
@@ -1723,6 +2884,50 @@ readstr(char* str, uint size, uint fd) {
 
 // === File Management ========================================================
 
+// FileInfo: gets the size of the file at path into info[0..1], and the time
+// and date it was last written into info[2..3].
+FileInfo(char *path, uint info[]) {
+  uint fd;
+  uint zero[2];
+  fd = safefopen(path, "r");
+  zero[0] = zero[1] = 0;
+  bseek(fd, zero, 2);
+  btell(fd, info);
+  FileStamp(fd, &info[2]);
+  safefclose(fd);
+}
+
+// FileStamp: gets the time and date of the last write to open file fd into
+// stamp[0] and stamp[1] (DOS function 57H). Zero if DOS returns an error.
+FileStamp(uint fd, uint stamp[]) {
+#asm
+  push bx         ; preserve secondary register
+  mov  bx,[bp+6]  ; get file descriptor
+  mov  ax,5700H   ; get file date and time
+  int  21h
+  jnc  __fstamp1
+  xor  cx,cx
+  xor  dx,dx
+__fstamp1:
+  mov  bx,[bp+4]  ; get address of stamp
+  mov  [bx],cx
+  mov  [bx+2],dx
+  pop  bx         ; restore secondary register
+#endasm
+}
+
+// SameName: returns 1 if the names match, ignoring case, as in FindPubDef.
+SameName(char *a, char *b) {
+  while (toupper(*a) == toupper(*b)) {
+    if (*a == 0) {
+      return 1;
+    }
+    a++;
+    b++;
+  }
+  return 0;
+}
+
 safefopen(char* path, char* opts) {
   uint fd;
   if (!(fd = fopen(path, opts))) {
@@ -1800,6 +3005,25 @@ AllocMem(int nItems, int itemSize) {
   return result;
 }
 
+// GrowMem: copies a table of *max items of itemSize bytes into a new block
+// with room for twice as many items, updates *max, and returns the new block.
+// Small-C can only free memory in the reverse order it was allocated, so the
+// old block is abandoned; tables start small so that this costs little.
+GrowMem(char *table, uint *max, int itemSize) {
+  char *result;
+  uint i, length;
+  length = *max * itemSize;
+  if (length > 0x7fff) {
+    fatalf("GrowMem: table of %u bytes cannot grow.", length);
+  }
+  result = AllocMem(*max * 2, itemSize);
+  for (i = 0; i < length; i++) {
+    result[i] = table[i];
+  }
+  *max *= 2;
+  return result;
+}
+
 // AddName: adds a null-terminated string to a byte array. Returns ptr to
 // byte array where string was placed. Fails if string will not fit.
 AddName(char *name, char *names, uint *next, uint max) {